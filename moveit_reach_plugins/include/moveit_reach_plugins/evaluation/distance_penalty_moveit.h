@@ -50,6 +50,8 @@ public:
 
   virtual double calculateScore(const std::map<std::string, double>& pose) override;
 
+  virtual reach::plugins::EvaluationBasePtr clone() const override;
+
 private:
 
   moveit::core::RobotModelConstPtr model_;
@@ -43,6 +43,8 @@ public:
 
   virtual double calculateScore(const std::map<std::string, double>& pose) override;
 
+  virtual reach::plugins::EvaluationBasePtr clone() const override;
+
 private:
 
   std::vector<std::vector<double>> getJointLimits();
@@ -35,8 +35,17 @@ public:
                                                   const std::map<std::string, double>& seed,
                                                   std::vector<double>& solution) override;
 
+  virtual void solveIKBatch(const reach::plugins::IsometryVector& targets,
+                            const std::vector<std::vector<double>>& seeds,
+                            std::vector<std::vector<double>>& solutions,
+                            std::vector<boost::optional<double>>& scores) override;
+
+  virtual reach::plugins::IKSolverBasePtr clone() const override;
+
 protected:
 
+  DiscretizedMoveItIKSolver(const DiscretizedMoveItIKSolver& other);
+
   double dt_;
 };
 
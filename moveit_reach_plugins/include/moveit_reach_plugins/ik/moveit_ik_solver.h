@@ -28,6 +28,7 @@ class RobotModel;
 typedef std::shared_ptr<const RobotModel> RobotModelConstPtr;
 class JointModelGroup;
 class RobotState;
+typedef std::shared_ptr<RobotState> RobotStatePtr;
 }
 }
 
@@ -54,10 +55,36 @@ public:
                                                   const std::map<std::string, double> &seed,
                                                   std::vector<double> &solution) override;
 
+  virtual void solveIKBatch(const reach::plugins::IsometryVector& targets,
+                            const std::vector<std::vector<double>>& seeds,
+                            std::vector<std::vector<double>>& solutions,
+                            std::vector<boost::optional<double>>& scores) override;
+
   virtual std::vector<std::string> getJointNames() const override;
 
+  virtual bool samplePoses(const std::size_t n,
+                           reach::plugins::IsometryVector& poses) override;
+
+  virtual reach::plugins::IKSolverBasePtr clone() const override;
+
 protected:
 
+  /**
+   * @brief Copy constructor used for cloning; the copy receives its own planning scene and evaluation plugin
+   * @param other
+   */
+  MoveItIKSolver(const MoveItIKSolver& other);
+
+  /**
+   * @brief solveIK solves IK for a target from a seed ordered as the active joints of the planning group, using the input robot state and
+   * solution map as scratch space
+   */
+  boost::optional<double> solveIK(moveit::core::RobotState& state,
+                                  std::map<std::string, double>& solution_map,
+                                  const Eigen::Isometry3d& target,
+                                  const std::vector<double>& seed,
+                                  std::vector<double>& solution) const;
+
   bool isIKSolutionValid(moveit::core::RobotState* state,
                          const moveit::core::JointModelGroup* jmg,
                          const double* ik_solution) const;
@@ -79,6 +106,12 @@ protected:
   std::string collision_mesh_frame_;
 
   std::vector<std::string> touch_links_;
+
+  /** @brief Scratch robot state reused across the targets of batched IK; created on first use */
+  moveit::core::RobotStatePtr batch_state_;
+
+  /** @brief Scratch joint name to position map reused across the targets of batched IK */
+  std::map<std::string, double> batch_solution_map_;
 };
 
 } // namespace ik
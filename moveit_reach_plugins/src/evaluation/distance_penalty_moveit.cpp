@@ -119,6 +119,14 @@ double DistancePenaltyMoveIt::calculateScore(const std::map<std::string, double>
   return std::pow((dist / dist_threshold_), exponent_);
 }
 
+reach::plugins::EvaluationBasePtr DistancePenaltyMoveIt::clone() const
+{
+  // Give the copy its own planning scene so that collision distance queries do not share state between threads
+  boost::shared_ptr<DistancePenaltyMoveIt> copy (new DistancePenaltyMoveIt(*this));
+  copy->scene_ = planning_scene::PlanningScene::clone(scene_);
+  return copy;
+}
+
 } // namespace evaluation
 } // namespace moveit_reach_plugins
 
@@ -91,6 +91,11 @@ double JointPenaltyMoveIt::calculateScore(const std::map<std::string, double>& p
   return std::max(0.0, 1.0 - std::exp(-1.0 * penalty));
 }
 
+reach::plugins::EvaluationBasePtr JointPenaltyMoveIt::clone() const
+{
+  return reach::plugins::EvaluationBasePtr(new JointPenaltyMoveIt(*this));
+}
+
 std::vector<std::vector<double>> JointPenaltyMoveIt::getJointLimits()
 {
   std::vector<double> max, min;
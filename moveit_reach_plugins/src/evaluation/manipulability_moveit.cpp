@@ -96,6 +96,11 @@ double ManipulabilityMoveIt::calculateScore(const std::map<std::string, double>&
   return m;
 }
 
+reach::plugins::EvaluationBasePtr ManipulabilityMoveIt::clone() const
+{
+  return reach::plugins::EvaluationBasePtr(new ManipulabilityMoveIt(*this));
+}
+
 } // namespace evaluation
 } // namespace moveit_reach_plugins
 
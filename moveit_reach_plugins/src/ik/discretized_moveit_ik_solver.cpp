@@ -43,6 +43,13 @@ DiscretizedMoveItIKSolver::DiscretizedMoveItIKSolver()
 
 }
 
+DiscretizedMoveItIKSolver::DiscretizedMoveItIKSolver(const DiscretizedMoveItIKSolver& other)
+  : MoveItIKSolver(other)
+  , dt_(other.dt_)
+{
+
+}
+
 bool DiscretizedMoveItIKSolver::initialize(XmlRpc::XmlRpcValue& config)
 {
   if(!MoveItIKSolver::initialize(config))
@@ -76,7 +83,7 @@ boost::optional<double> DiscretizedMoveItIKSolver::solveIKFromSeed(const Eigen::
                                                                    std::vector<double>& solution)
 {
   // Calculate the number of discretizations necessary to achieve discretization angle
-  const static int n_discretizations = int((2.0*M_PI) / dt_);
+  const int n_discretizations = int((2.0*M_PI) / dt_);
 
   // Set up containers for the best solution to be saved into the database
   std::vector<double> best_solution;
@@ -110,6 +117,65 @@ boost::optional<double> DiscretizedMoveItIKSolver::solveIKFromSeed(const Eigen::
   }
 }
 
+void DiscretizedMoveItIKSolver::solveIKBatch(const reach::plugins::IsometryVector& targets,
+                                             const std::vector<std::vector<double>>& seeds,
+                                             std::vector<std::vector<double>>& solutions,
+                                             std::vector<boost::optional<double>>& scores)
+{
+  const int n_discretizations = int((2.0*M_PI) / dt_);
+
+  solutions.assign(targets.size(), std::vector<double>());
+  scores.assign(targets.size(), boost::none);
+
+  // Solve all of the discretized orientations of a target as one batch
+  reach::plugins::IsometryVector discretized_targets (n_discretizations);
+  std::vector<std::vector<double>> discretized_seeds (n_discretizations);
+  std::vector<std::vector<double>> discretized_solutions;
+  std::vector<boost::optional<double>> discretized_scores;
+
+  for(std::size_t t = 0; t < targets.size(); ++t)
+  {
+    for(int i = 0; i < n_discretizations; ++i)
+    {
+      discretized_targets[i] = targets[t] * Eigen::AngleAxisd (double(i)*dt_, Eigen::Vector3d::UnitZ());
+      discretized_seeds[i] = seeds[t];
+    }
+
+    MoveItIKSolver::solveIKBatch(discretized_targets, discretized_seeds, discretized_solutions, discretized_scores);
+
+    // Keep the best solution
+    double best_score = 0;
+    for(int i = 0; i < n_discretizations; ++i)
+    {
+      if(discretized_scores[i] && (*discretized_scores[i] > best_score))
+      {
+        best_score = *discretized_scores[i];
+        solutions[t] = std::move(discretized_solutions[i]);
+      }
+    }
+
+    if(best_score > 0)
+    {
+      scores[t] = best_score;
+    }
+    else
+    {
+      solutions[t].clear();
+    }
+  }
+}
+
+reach::plugins::IKSolverBasePtr DiscretizedMoveItIKSolver::clone() const
+{
+  boost::shared_ptr<DiscretizedMoveItIKSolver> copy (new DiscretizedMoveItIKSolver(*this));
+  if(!copy->eval_)
+  {
+    ROS_WARN("Evaluation plugin does not support cloning; unable to clone DiscretizedMoveItIKSolver");
+    return nullptr;
+  }
+  return copy;
+}
+
 } // namespace ik
 } // namespace moveit_reach_plugins
 
@@ -36,6 +36,21 @@ MoveItIKSolver::MoveItIKSolver()
 
 }
 
+MoveItIKSolver::MoveItIKSolver(const MoveItIKSolver& other)
+  : reach::plugins::IKSolverBase()
+  , model_(other.model_)
+  , scene_(planning_scene::PlanningScene::clone(other.scene_))
+  , jmg_(other.jmg_)
+  , class_loader_(PACKAGE, EVAL_PLUGIN_BASE)
+  , eval_(other.eval_->clone())
+  , distance_threshold_(other.distance_threshold_)
+  , collision_mesh_filename_(other.collision_mesh_filename_)
+  , collision_mesh_frame_(other.collision_mesh_frame_)
+  , touch_links_(other.touch_links_)
+{
+
+}
+
 bool MoveItIKSolver::initialize(XmlRpc::XmlRpcValue& config)
 {
   if(!config.hasMember("planning_group") ||
@@ -138,7 +153,41 @@ boost::optional<double> MoveItIKSolver::solveIKFromSeed(const Eigen::Isometry3d&
     return {};
   }
 
-  state.setJointGroupPositions(jmg_, seed_subset);
+  std::map<std::string, double> solution_map;
+  return solveIK(state, solution_map, target, seed_subset, solution);
+}
+
+void MoveItIKSolver::solveIKBatch(const reach::plugins::IsometryVector& targets,
+                                  const std::vector<std::vector<double>>& seeds,
+                                  std::vector<std::vector<double>>& solutions,
+                                  std::vector<boost::optional<double>>& scores)
+{
+  // Unlike solveIKFromSeed, which may be called concurrently, batched IK reuses the scratch state of this solver
+  if(!batch_state_)
+  {
+    batch_state_.reset(new moveit::core::RobotState (model_));
+  }
+
+  solutions.resize(targets.size());
+  scores.resize(targets.size());
+
+  for(std::size_t i = 0; i < targets.size(); ++i)
+  {
+    scores[i] = solveIK(*batch_state_, batch_solution_map_, targets[i], seeds[i], solutions[i]);
+    if(!scores[i])
+    {
+      solutions[i].clear();
+    }
+  }
+}
+
+boost::optional<double> MoveItIKSolver::solveIK(moveit::core::RobotState& state,
+                                                std::map<std::string, double>& solution_map,
+                                                const Eigen::Isometry3d& target,
+                                                const std::vector<double>& seed,
+                                                std::vector<double>& solution) const
+{
+  state.setJointGroupPositions(jmg_, seed);
   state.update();
 
   const static int SOLUTION_ATTEMPTS = 3;
@@ -150,10 +199,10 @@ boost::optional<double> MoveItIKSolver::solveIKFromSeed(const Eigen::Isometry3d&
     state.copyJointGroupPositions(jmg_, solution);
 
     // Convert back to map
-    std::map<std::string, double> solution_map;
+    const std::vector<std::string>& joint_names = jmg_->getActiveJointModelNames();
     for(std::size_t i = 0; i < solution.size(); ++i)
     {
-      solution_map.emplace(joint_names[i], solution[i]);
+      solution_map[joint_names[i]] = solution[i];
     }
 
     return eval_->calculateScore(solution_map);
@@ -182,6 +231,54 @@ std::vector<std::string> MoveItIKSolver::getJointNames() const
   return jmg_->getActiveJointModelNames();
 }
 
+bool MoveItIKSolver::samplePoses(const std::size_t n,
+                                 reach::plugins::IsometryVector& poses)
+{
+  // Sample the poses of the frame that the IK solver places at the targets, which is not necessarily the last link of the group
+  const kinematics::KinematicsBaseConstPtr& ik_solver = jmg_->getSolverInstance();
+  const moveit::core::LinkModel* tip = ik_solver ? model_->getLinkModel(ik_solver->getTipFrame()) : nullptr;
+  if(!tip)
+  {
+    ROS_ERROR_STREAM("Failed to get the IK tip frame of planning group '" << jmg_->getName() << "'");
+    return false;
+  }
+
+  moveit::core::RobotState state (model_);
+  state.setToDefaultValues();
+
+  // Only self-collisions are considered, since the workspace of the robot is independent of the reach object
+  collision_detection::CollisionRequest req;
+  req.group_name = jmg_->getName();
+
+  poses.clear();
+  poses.reserve(n);
+  for(std::size_t i = 0; i < n; ++i)
+  {
+    state.setToRandomPositions(jmg_);
+    state.update();
+
+    collision_detection::CollisionResult res;
+    scene_->checkSelfCollision(req, res, state);
+    if(!res.collision)
+    {
+      poses.push_back(state.getGlobalLinkTransform(tip));
+    }
+  }
+
+  return true;
+}
+
+reach::plugins::IKSolverBasePtr MoveItIKSolver::clone() const
+{
+  boost::shared_ptr<MoveItIKSolver> copy (new MoveItIKSolver(*this));
+  if(!copy->eval_)
+  {
+    ROS_WARN("Evaluation plugin does not support cloning; unable to clone MoveItIKSolver");
+    return nullptr;
+  }
+  return copy;
+}
+
 } // namespace ik
 } // namespace moveit_reach_plugins
 
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2019 Southwest Research Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef REACH_CORE_CAPABILITY_MAP_H
+#define REACH_CORE_CAPABILITY_MAP_H
+
+#include <reach_core/plugins/ik_solver_base.h>
+#include <reach_core/utils/task_pool.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace reach
+{
+namespace core
+{
+
+/**
+ * @brief The CapabilityMap class is a voxelized map of the robot workspace which stores, for each voxel, the fraction of tool
+ * orientations with which the robot can reach the voxel. The approach direction (Z axis) of the tool is discretized into a fixed number
+ * of bins, and the map is built by sampling random collision-free robot configurations. Voxels that were never reached by a sample are
+ * not stored and have a reachability of zero
+ */
+class CapabilityMap
+{
+public:
+
+  /**
+   * @brief CapabilityMap
+   * @param resolution edge length of the voxels
+   */
+  explicit CapabilityMap(const double resolution);
+
+  /**
+   * @brief build samples the input number of robot configurations with the input IK solvers (one per worker of the task pool)
+   * @param pool
+   * @param solvers
+   * @param n_samples
+   * @return false if the IK solvers do not support sampling
+   */
+  bool build(utils::TaskPool& pool,
+             const std::vector<reach::plugins::IKSolverBasePtr>& solvers,
+             const std::size_t n_samples);
+
+  /**
+   * @brief save saves the map to a file at the input location
+   * @param filename
+   * @param key identifies the robot and settings with which the map was built
+   * @return
+   */
+  bool save(const std::string& filename,
+            const std::string& key) const;
+
+  /**
+   * @brief load loads a saved map from the input location
+   * @param filename
+   * @param key the map is only loaded if it was saved with the same key
+   * @return
+   */
+  bool load(const std::string& filename,
+            const std::string& key);
+
+  /**
+   * @brief getReachability returns the largest fraction of reachable orientations of the voxel containing the input position and its
+   * adjacent voxels, which compensates for voxels that were missed by the finite number of samples
+   * @param position
+   * @return
+   */
+  float getReachability(const Eigen::Vector3d& position) const;
+
+  /**
+   * @brief size returns the number of reachable voxels
+   * @return
+   */
+  std::size_t size() const
+  {
+    return map_.size();
+  }
+
+private:
+
+  std::int64_t getKey(const long x, const long y, const long z) const;
+
+  double resolution_;
+
+  std::unordered_map<std::int64_t, float> map_;
+};
+typedef std::shared_ptr<CapabilityMap> CapabilityMapPtr;
+
+} // namespace core
+} // namespace reach
+
+#endif // REACH_CORE_CAPABILITY_MAP_H
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2019 Southwest Research Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef REACH_CORE_COMPONENT_ANALYSIS_H
+#define REACH_CORE_COMPONENT_ANALYSIS_H
+
+#include <reach_core/neighbor_graph.h>
+#include <reach_core/reach_database.h>
+#include <reach_core/transition_cache.h>
+#include <reach_core/plugins/ik_solver_base.h>
+#include <reach_core/utils/task_pool.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace reach
+{
+namespace core
+{
+
+/**
+ * @brief The ComponentAnalysis class groups the reached records of a database into components that are continuous in joint space: two
+ * neighboring records are connected if IK for the target of one is solved when seeded with the solution of the other. Each edge of the
+ * neighbor graph between reached records is solved once, and its result is used both to join the components of its records and to
+ * accumulate the joint distance of the transition, so the analysis costs one IK solution per edge rather than one flood fill per record
+ *
+ * The metrics of the analysis are not the metrics of the flood fill (see reachNeighborsRecursive) that the study stores by default, and
+ * the two are not comparable:
+ *  - Each edge is solved in one direction only, from the record with the lower ID, seeded with its stored solution, and a solved edge
+ *    connects both records. The flood fill solves each transition in the direction it expands, seeded with the solution found along the
+ *    way, so the records it reaches from a record are not necessarily those that reach it
+ *  - The average connected count is sum(k * (k - 1)) / N over the components, with k records each, and the N records of the database.
+ *    The average neighbor count of the flood fill is the number of records reached by the fill from each reached record, divided by N
+ *  - The average edge joint distance is the mean joint distance of the solved edges. The average joint distance of the flood fill is the
+ *    total joint distance of the transitions of every fill, divided by the total number of records reached by the fills
+ */
+class ComponentAnalysis
+{
+public:
+
+  /**
+   * @brief run solves the edges of the neighbor graph in parallel and joins the records they connect with a concurrent union-find.
+   * Must not be called from a worker thread of the pool
+   * @param pool
+   * @param solvers one IK solver per worker of the pool
+   * @param db
+   * @param graph neighbor graph of the database
+   * @param cache cache of the transitions, which answers the edges that were solved before for the same solutions
+   */
+  void run(utils::TaskPool& pool,
+           const std::vector<reach::plugins::IKSolverBasePtr>& solvers,
+           const ReachDatabase& db,
+           const NeighborGraph& graph,
+           TransitionCachePtr cache = nullptr);
+
+  /**
+   * @brief getComponent returns the representative ID of the component of the record with the input ID; records of the same component
+   * have the same representative
+   * @param id
+   * @return
+   */
+  std::size_t getComponent(const std::size_t id) const;
+
+  /**
+   * @brief getComponentSizes returns the number of records of each component, in descending order
+   * @return
+   */
+  const std::vector<std::size_t>& getComponentSizes() const
+  {
+    return component_sizes_;
+  }
+
+  /**
+   * @brief getAverageConnectedCount returns the average, over all records of the database, of the number of other records in the same
+   * component
+   * @return
+   */
+  float getAverageConnectedCount() const
+  {
+    return avg_connected_count_;
+  }
+
+  /**
+   * @brief getAverageEdgeJointDistance returns the average joint distance between the seed and solution of the solved edges
+   * @return
+   */
+  float getAverageEdgeJointDistance() const
+  {
+    return avg_edge_joint_distance_;
+  }
+
+  /**
+   * @brief getTransitionCount returns the number of edges whose IK was solved
+   * @return
+   */
+  std::size_t getTransitionCount() const
+  {
+    return n_transitions_;
+  }
+
+private:
+
+  std::uint32_t find(std::uint32_t id) const;
+
+  void unite(std::uint32_t a, std::uint32_t b);
+
+  /** @brief Parent of each ID in the union-find forest; IDs of unreached records are their own roots */
+  mutable std::vector<std::atomic<std::uint32_t>> parents_;
+
+  std::vector<std::size_t> component_sizes_;
+  float avg_connected_count_ = 0.0f;
+  float avg_edge_joint_distance_ = 0.0f;
+  std::size_t n_transitions_ = 0;
+};
+
+} // namespace core
+} // namespace reach
+
+#endif // REACH_CORE_COMPONENT_ANALYSIS_H
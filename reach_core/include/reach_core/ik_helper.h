@@ -16,13 +16,15 @@
 #ifndef REACH_CORE_IK_HELPER_H
 #define REACH_CORE_IK_HELPER_H
 
+#include <reach_core/neighbor_graph.h>
 #include <reach_core/reach_database.h>
+#include <reach_core/spatial_index.h>
 #include <reach_core/study_parameters.h>
+#include <reach_core/transition_cache.h>
 #include <reach_core/plugins/ik_solver_base.h>
+#include <reach_core/utils/task_pool.h>
 
 #include <boost/optional.hpp>
-#include <flann/flann.h>
-#include <flann/algorithms/kdtree_single_index.h>
 
 namespace reach
 {
@@ -32,24 +34,90 @@ namespace core
 struct NeighborReachResult
 {
   std::vector<std::string> reached_pts;
+  /** @brief IDs of the records that were overwritten with a better solution, paired with the resulting increase in score */
+  std::vector<std::pair<std::string, double>> updated_pts;
   double joint_distance = 0;
 };
 
-typedef flann::KDTreeSingleIndex<flann::L2_3D<double>> SearchTree;
-typedef std::shared_ptr<SearchTree> SearchTreePtr;
+/**
+ * @brief solveTransitions solves IK for the goal pose of each target record, seeded with the solution of a source record, and answers the
+ * transitions that are already in the cache without calling the solver
+ * @param solver
+ * @param source ID of the source record
+ * @param version version of the source record when its solution was read
+ * @param seed solution of the source record, ordered as the joints of the solver
+ * @param targets
+ * @param solutions the IK solution of each target (empty if no solution was found)
+ * @param scores the score of each target's solution (uninitialized if no solution was found)
+ * @param cache
+ */
+void solveTransitions(reach::plugins::IKSolverBasePtr solver,
+                      const std::size_t source,
+                      const std::uint64_t version,
+                      const std::vector<double>& seed,
+                      const std::vector<reach_msgs::ReachRecord>& targets,
+                      std::vector<std::vector<double>>& solutions,
+                      std::vector<boost::optional<double>>& scores,
+                      TransitionCachePtr cache = nullptr);
+
+/**
+ * @brief getNeighbors returns the records other than the input record whose goal positions lie within the radius of its goal position
+ * @param rec
+ * @param db
+ * @param radius
+ * @param spatial_index index of the records of the database; without one, the goal positions of all records within the bounding box of
+ * the neighborhood are checked
+ * @param neighbor_graph neighbor graph of the database, which is used instead of searching if it was built with the same radius
+ * @return
+ */
+std::vector<reach_msgs::ReachRecord> getNeighbors(const reach_msgs::ReachRecord& rec,
+                                                  const ReachDatabasePtr db,
+                                                  const double radius,
+                                                  SpatialIndexPtr spatial_index = nullptr,
+                                                  NeighborGraphPtr neighbor_graph = nullptr);
 
 NeighborReachResult reachNeighborsDirect(std::shared_ptr<ReachDatabase> db,
                                          const reach_msgs::ReachRecord& rec,
                                          reach::plugins::IKSolverBasePtr solver,
                                          const double radius,
-                                         SearchTreePtr search_tree = nullptr);
-
-void reachNeighborsRecursive(std::shared_ptr<ReachDatabase> db,
-                             const reach_msgs::ReachRecord& msg,
-                             reach::plugins::IKSolverBasePtr solver,
-                             const double radius,
-                             NeighborReachResult result,
-                             SearchTreePtr search_tree = nullptr);
+                                         SpatialIndexPtr spatial_index = nullptr,
+                                         NeighborGraphPtr neighbor_graph = nullptr,
+                                         TransitionCachePtr cache = nullptr);
+
+/**
+ * @brief reachNeighborsRecursive finds the records that can be reached from the input record by repeatedly solving IK for the neighbors of
+ * reached records, seeded with the solutions of the records they were reached from. The region is flood filled one frontier at a time,
+ * without modifying the database
+ * @param db
+ * @param msg
+ * @param solver
+ * @param radius
+ * @param spatial_index
+ * @param neighbor_graph
+ * @param cache
+ * @return the IDs of the reached records, starting with the input record, and the total joint distance between the seeds and solutions
+ */
+NeighborReachResult reachNeighborsRecursive(std::shared_ptr<ReachDatabase> db,
+                                            const reach_msgs::ReachRecord& msg,
+                                            reach::plugins::IKSolverBasePtr solver,
+                                            const double radius,
+                                            SpatialIndexPtr spatial_index = nullptr,
+                                            NeighborGraphPtr neighbor_graph = nullptr,
+                                            TransitionCachePtr cache = nullptr);
+
+/**
+ * @brief reachNeighborsRecursive expands the records of each frontier in parallel on the workers of a pool. Must not be called from a
+ * worker thread of the pool
+ * @param solvers one IK solver per worker of the pool
+ */
+NeighborReachResult reachNeighborsRecursive(std::shared_ptr<ReachDatabase> db,
+                                            const reach_msgs::ReachRecord& msg,
+                                            utils::TaskPool& pool,
+                                            const std::vector<reach::plugins::IKSolverBasePtr>& solvers,
+                                            const double radius,
+                                            SpatialIndexPtr spatial_index = nullptr,
+                                            NeighborGraphPtr neighbor_graph = nullptr,
+                                            TransitionCachePtr cache = nullptr);
 
 } // namespace core
 } // namespace reach
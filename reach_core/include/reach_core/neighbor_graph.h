@@ -0,0 +1,145 @@
+/*
+ * Copyright 2019 Southwest Research Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef REACH_CORE_NEIGHBOR_GRAPH_H
+#define REACH_CORE_NEIGHBOR_GRAPH_H
+
+#include <reach_core/reach_database.h>
+#include <reach_core/spatial_index.h>
+#include <reach_core/utils/task_pool.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace reach
+{
+namespace core
+{
+
+/**
+ * @brief The NeighborGraph class stores, for every record of a database, the records whose goal positions lie within a fixed radius of its
+ * goal position, with the distances between them. The graph is stored in compressed sparse row form: the neighbors of all records are
+ * stored contiguously in order of ID, with the offset of the neighbors of each ID. The graph only depends on the goal positions of the
+ * records, so it is built once per set of target points and radius, and can be saved and reused by later runs of a study
+ */
+class NeighborGraph
+{
+public:
+
+  /**
+   * @brief The Neighbors struct is a view of the neighbors of a record, which can be iterated over for their IDs
+   */
+  struct Neighbors
+  {
+    const std::uint32_t* ids;
+    const float* distances;
+    std::size_t size;
+
+    const std::uint32_t* begin() const
+    {
+      return ids;
+    }
+
+    const std::uint32_t* end() const
+    {
+      return ids + size;
+    }
+  };
+
+  /**
+   * @brief build finds the neighbors of every record of the database in parallel
+   * @param pool
+   * @param db
+   * @param index spatial index of the records of the database, which must be up to date
+   * @param radius
+   */
+  void build(utils::TaskPool& pool,
+             const ReachDatabase& db,
+             const SpatialIndex& index,
+             const double radius);
+
+  /**
+   * @brief save saves the graph to a file at the input location
+   * @param filename
+   * @return
+   */
+  bool save(const std::string& filename) const;
+
+  /**
+   * @brief load loads a saved graph from the input location
+   * @param filename
+   * @return
+   */
+  bool load(const std::string& filename);
+
+  /**
+   * @brief matches returns whether the graph was built with the input radius for the current goal positions of the records of the input
+   * database
+   * @param db
+   * @param radius
+   * @return
+   */
+  bool matches(const ReachDatabase& db,
+               const double radius) const;
+
+  /**
+   * @brief hasRadius returns whether the graph was built with the input radius. Radii are compared with a relative tolerance, so that a
+   * radius read back from a file or computed differently still selects the graph
+   * @param radius
+   * @return
+   */
+  bool hasRadius(const double radius) const;
+
+  /**
+   * @brief getNeighbors returns the neighbors of the record with the input ID, in order of ID, excluding the record itself
+   * @param id
+   * @return an empty view if the record has no neighbors or is not in the graph
+   */
+  Neighbors getNeighbors(const std::size_t id) const;
+
+  double getRadius() const
+  {
+    return radius_;
+  }
+
+  /**
+   * @brief size returns the number of directed edges of the graph
+   * @return
+   */
+  std::size_t size() const
+  {
+    return targets_.size();
+  }
+
+private:
+
+  /** @brief Hash of the IDs and goal positions of the records, identifying the target points the graph was built for */
+  static std::uint64_t getFingerprint(const ReachDatabase& db);
+
+  double radius_ = 0.0;
+  std::uint64_t fingerprint_ = 0;
+
+  /** @brief Offset of the neighbors of each ID into the neighbor arrays, plus the total number of neighbors */
+  std::vector<std::uint64_t> offsets_;
+  std::vector<std::uint32_t> targets_;
+  std::vector<float> distances_;
+};
+typedef std::shared_ptr<NeighborGraph> NeighborGraphPtr;
+
+} // namespace core
+} // namespace reach
+
+#endif // REACH_CORE_NEIGHBOR_GRAPH_H
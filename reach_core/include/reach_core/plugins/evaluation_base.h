@@ -17,6 +17,8 @@
 #define REACH_CORE_PLUGINS_EVALUATION_EVALUATION_BASE
 
 #include <boost/shared_ptr.hpp>
+#include <map>
+#include <string>
 #include <vector>
 #include <xmlrpcpp/XmlRpcValue.h>
 
@@ -25,6 +27,9 @@ namespace reach
 namespace plugins
 {
 
+class EvaluationBase;
+typedef boost::shared_ptr<EvaluationBase> EvaluationBasePtr;
+
 /**
  * @brief The EvaluationBase class
  */
@@ -55,8 +60,17 @@ public:
    */
   virtual double calculateScore(const std::map<std::string, double>& pose) = 0;
 
+  /**
+   * @brief clone creates an independent copy of this initialized plugin such that the copy and the original can be used concurrently
+   * from different threads
+   * @return a pointer to the copy, or nullptr if the plugin does not support cloning
+   */
+  virtual EvaluationBasePtr clone() const
+  {
+    return nullptr;
+  }
+
 };
-typedef boost::shared_ptr<EvaluationBase> EvaluationBasePtr;
 
 } // namespace plugins
 } // namespace reach
@@ -17,15 +17,24 @@
 #define REACH_CORE_PLUGINS_IK_IK_SOLVER_BASE_H
 
 #include <boost/optional.hpp>
+#include <boost/shared_ptr.hpp>
+#include <map>
+#include <string>
 #include <vector>
 #include <xmlrpcpp/XmlRpcValue.h>
 #include <Eigen/Dense>
+#include <Eigen/StdVector>
 
 namespace reach
 {
 namespace plugins
 {
 
+class IKSolverBase;
+typedef boost::shared_ptr<IKSolverBase> IKSolverBasePtr;
+
+typedef std::vector<Eigen::Isometry3d, Eigen::aligned_allocator<Eigen::Isometry3d>> IsometryVector;
+
 /**
  * @brief Base class solving IK at a given reach study location
  */
@@ -61,14 +70,73 @@ public:
                                                   const std::map<std::string, double>& seed,
                                                   std::vector<double>& solution) = 0;
 
+  /**
+   * @brief solveIKBatch attempts to find a valid IK solution for each of the given target poses, starting from the corresponding seed state.
+   * Seed states and solutions are ordered as the joint names returned by getJointNames. The default implementation calls solveIKFromSeed
+   * for each target; solvers can override it to share setup costs across the targets of the batch
+   * @param targets
+   * @param seeds
+   * @param solutions the IK solution of each target (empty if no solution was found)
+   * @param scores the score of each target's solution (uninitialized if no solution was found)
+   */
+  virtual void solveIKBatch(const IsometryVector& targets,
+                            const std::vector<std::vector<double>>& seeds,
+                            std::vector<std::vector<double>>& solutions,
+                            std::vector<boost::optional<double>>& scores)
+  {
+    const std::vector<std::string> joint_names = getJointNames();
+
+    solutions.assign(targets.size(), std::vector<double>());
+    scores.assign(targets.size(), boost::none);
+
+    std::map<std::string, double> seed_map;
+    for(std::size_t i = 0; i < targets.size(); ++i)
+    {
+      for(std::size_t j = 0; j < joint_names.size(); ++j)
+      {
+        seed_map[joint_names[j]] = seeds[i][j];
+      }
+
+      scores[i] = solveIKFromSeed(targets[i], seed_map, solutions[i]);
+
+      // Do not pass on whatever the solver left in the solution of a failed target
+      if(!scores[i])
+      {
+        solutions[i].clear();
+      }
+    }
+  }
+
   /**
    * @brief getJointNames
    * @return
    */
   virtual std::vector<std::string> getJointNames() const = 0;
 
+  /**
+   * @brief samplePoses samples random collision-free configurations of the robot and returns the resulting poses of the IK target frame,
+   * which are used to build a capability map of the robot workspace
+   * @param n number of configurations to sample
+   * @param poses
+   * @return false if the solver does not support sampling
+   */
+  virtual bool samplePoses(const std::size_t n,
+                           IsometryVector& poses)
+  {
+    return false;
+  }
+
+  /**
+   * @brief clone creates an independent copy of this initialized solver (including its own planning environment, evaluation plugin,
+   * and scratch state) such that the copy and the original can be used concurrently from different threads
+   * @return a pointer to the copy, or nullptr if the solver does not support cloning
+   */
+  virtual IKSolverBasePtr clone() const
+  {
+    return nullptr;
+  }
+
 };
-typedef boost::shared_ptr<IKSolverBase> IKSolverBasePtr;
 
 } // namespace plugins
 } // namespace reach
@@ -34,6 +34,8 @@ public:
 
   virtual double calculateScore(const std::map<std::string, double>& pose) override;
 
+  virtual EvaluationBasePtr clone() const override;
+
 private:
 
   std::vector<EvaluationBasePtr> eval_plugins_;  
@@ -17,10 +17,18 @@
 #define REACH_CORE_REACH_DATABASE_H
 
 #include "reach_core/study_parameters.h"
+#include "reach_core/utils/mapped_file.h"
 #include <reach_msgs/ReachDatabase.h>
 #include <boost/optional.hpp>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <iterator>
+#include <limits>
+#include <memory>
 #include <mutex>
-#include <unordered_map>
+#include <thread>
 
 namespace reach
 {
@@ -51,6 +59,102 @@ reach_msgs::ReachRecord makeRecord(const std::string &id,
  */
 std::map<std::string, double> jointStateMsgToMap(const sensor_msgs::JointState& state);
 
+/**
+ * @brief The ScoreStatistics struct holds aggregates of the records of a database, which the database keeps up to date as records are
+ * written. The scores of the reached records are counted in a histogram with logarithmically spaced bins (SUB_BINS per power of two
+ * between MIN_SCORE and MAX_SCORE), so the minimum, maximum and percentiles estimated from it are within about 5% of the true values.
+ * Scores below MIN_SCORE (including zero and negative scores) are counted in the first bin and estimated as zero, and scores above
+ * MAX_SCORE are counted in the last bin and estimated as MAX_SCORE
+ */
+struct ScoreStatistics
+{
+  const static int SUB_BINS = 8;
+  const static int MIN_EXPONENT = -20;
+  const static int MAX_EXPONENT = 20;
+  const static std::size_t N_BINS = (MAX_EXPONENT - MIN_EXPONENT) * SUB_BINS + 2;
+
+  std::size_t n_records = 0;
+  std::size_t n_reached = 0;
+  double total_score = 0.0;
+  std::array<std::size_t, N_BINS> histogram {};
+
+  /** @brief Adds the statistics of another set of records, such as a different stripe of the same database */
+  ScoreStatistics& operator+=(const ScoreStatistics& other);
+
+  /** @brief Adds (count = 1) or removes (count = -1) a record */
+  void update(const bool reached, const double score, const int count);
+
+  /**
+   * @brief getPercentile estimates the score below which the input percentage of the reached scores lie
+   * @param percent in [0, 100]
+   * @return 0 if no records were reached
+   */
+  double getPercentile(const double percent) const;
+
+  double getMinimum() const
+  {
+    return getPercentile(0.0);
+  }
+
+  double getMaximum() const
+  {
+    return getPercentile(100.0);
+  }
+
+  static std::size_t getBin(const double score);
+
+  /** @brief Returns the geometric center of a bin */
+  static double getBinValue(const std::size_t bin);
+};
+
+/**
+ * @brief The RecordView struct holds the scalar fields of a record, as returned by queries. Unlike a ReachRecord message it holds no joint
+ * states or strings; use ReachDatabase::get with the ID for the full record
+ */
+struct RecordView
+{
+  std::size_t id;
+  bool reached;
+  bool interpolated;
+  double score;
+  geometry_msgs::Point position;
+};
+
+/**
+ * @brief The ReachQuery struct selects records of a database. A record matches if it matches every criterion; the default query matches
+ * every record. The ID range and bounds are inclusive
+ */
+struct ReachQuery
+{
+  enum class Order
+  {
+    ID,
+    SCORE_ASCENDING,
+    SCORE_DESCENDING
+  };
+
+  /** @brief An axis-aligned box of goal positions */
+  struct Box
+  {
+    geometry_msgs::Point min;
+    geometry_msgs::Point max;
+  };
+
+  boost::optional<bool> reached;
+  boost::optional<bool> interpolated;
+  double min_score = -std::numeric_limits<double>::infinity();
+  double max_score = std::numeric_limits<double>::infinity();
+  std::size_t min_id = 0;
+  std::size_t max_id = std::numeric_limits<std::size_t>::max();
+  boost::optional<Box> box;
+
+  /** @brief Order of the results; results ordered by score are ordered by ID among equal scores */
+  Order order = Order::ID;
+  /** @brief Maximum number of results, taken from the start of the order; e.g. the worst 1% of the reached records is the query with
+   * reached set, ascending score order and a limit of 1% of the number of reached records */
+  std::size_t limit = std::numeric_limits<std::size_t>::max();
+};
+
 /**
  * @brief The Database class stores information about the robot pose for all of the attempted target poses. The database also saves
  * several key meta-results of the reach study:
@@ -61,18 +165,80 @@ std::map<std::string, double> jointStateMsgToMap(const sensor_msgs::JointState&
  *    area from a given pose, assuming the poses on the reach object are evenly distributed)
  *  - avg_joint_distance: average joint distance required to travel to all of any given pose's reachable neighbors (indicative of the
  *    robot's ease of movement or "efficiency" moving from one pose to a neighboring pose
+ *  - neighbor_analysis: the method that computed the two neighbor metrics, whose values are only comparable between databases that used
+ *    the same method
+ *
+ * Record IDs must be non-negative integers (the index of the target point in the reach object point cloud). The records are stored in
+ * contiguous arrays indexed by ID, with one array per field, and the joint names are stored once for the whole database. ReachRecord
+ * messages are only created when records are read from the database
+ *
+ * The records are divided into stripes by ID, each guarded by its own mutex, so that concurrent workers can read and write different
+ * records without serializing on a single lock. Operations that move records (adding the first record or growing the arrays) and
+ * operations that need a consistent snapshot of the whole database (saving, listing interpolated records, creating a database message)
+ * lock every stripe. Call reserve() with the number of target points before writing from several threads so that the arrays never need
+ * to grow
+ *
+ * Databases are saved in a versioned columnar binary format: a header with the summary results and the offsets of the columns, the joint
+ * names, and one fixed-width column per field with a slot per ID. Saved databases are loaded by mapping the file into memory and copying
+ * the columns directly into the arrays; the seed and goal state columns, which make up most of the file, are only read from the mapping
+ * as records are accessed, until the database is first modified. Databases saved as serialized ReachDatabase messages by earlier versions
+ * can still be loaded. With compression enabled (see setCompression()), the columns are divided into chunks of consecutive IDs, each
+ * compressed separately, and the goal poses and joint states are rounded to configurable resolutions first. The columns of large databases
+ * are copied, compressed and decompressed one chunk per thread
+ *
+ * While a study modifies the database for a long time, startLog() appends every change to a log file next to the saved database from a
+ * background thread. Each stripe buffers the log entries of its changes, and the thread collects the buffers of all stripes in batches.
+ * Saving the database to the same file compacts the log: the saved snapshot holds all changes up to that point, and the log restarts
+ * empty. After an interruption, replayLog() recovers the changes made since the last save, except those still buffered at the time
  */
 class ReachDatabase
 {
-  using iterator = std::unordered_map<std::string, reach_msgs::ReachRecord>::iterator;
-
 public:
 
+  /**
+   * @brief The const_iterator class iterates over the records of the database in order of ID, creating a ReachRecord message for each
+   */
+  class const_iterator : public std::iterator<std::forward_iterator_tag, reach_msgs::ReachRecord>
+  {
+  public:
+
+    const_iterator(const ReachDatabase* db, const std::size_t id);
+
+    reach_msgs::ReachRecord operator*() const;
+
+    std::unique_ptr<reach_msgs::ReachRecord> operator->() const
+    {
+      return std::unique_ptr<reach_msgs::ReachRecord>(new reach_msgs::ReachRecord(**this));
+    }
+
+    const_iterator& operator++();
+
+    bool operator==(const const_iterator& other) const
+    {
+      return id_ == other.id_;
+    }
+
+    bool operator!=(const const_iterator& other) const
+    {
+      return id_ != other.id_;
+    }
+
+  private:
+
+    const ReachDatabase* db_;
+    std::size_t id_;
+  };
+
   /**
     @brief Default class constructor
    */
   ReachDatabase() = default;
 
+  /**
+   * @brief Stops the log, if it is running, once all pending changes are written
+   */
+  ~ReachDatabase();
+
   /**
    * @brief save saves the reach study database to a file at the input location
    * @param filename
@@ -80,12 +246,64 @@ public:
   void save(const std::string& filename) const;
 
   /**
-   * @brief load loads a saved reach study database from the input location
+   * @brief setCompression sets whether and how databases are compressed when they are saved. Compressed databases are decoded into memory
+   * when they are loaded, rather than read lazily from the file
+   * @param compression
+   */
+  void setCompression(const StudyCompression& compression);
+
+  /**
+   * @brief load loads a saved reach study database from the input location, in either the columnar or the legacy message format. The
+   * records are merged into the records already in the database
    * @param filename
    * @return true on success, false on failure
    */
   bool load(const std::string& filename);
 
+  /**
+   * @brief loadResults reads only the summary results of a saved reach study database, without reading any of its records. The results
+   * are read from the header of a columnar database file, or from the end of a database saved in the legacy message format
+   * @param filename
+   * @param results
+   * @return true on success, false on failure
+   */
+  static bool loadResults(const std::string& filename,
+                          StudyResults& results);
+
+  /**
+   * @brief remove deletes a saved reach study database and its associated files from the input location
+   * @param filename
+   */
+  static void remove(const std::string& filename);
+
+  /**
+   * @brief rename moves a saved reach study database and its associated files to the input location, replacing any database saved there.
+   * Nothing is changed if no database is saved at the original location
+   * @param filename
+   * @param new_filename
+   */
+  static void rename(const std::string& filename,
+                     const std::string& new_filename);
+
+  /**
+   * @brief startLog saves the database to the input location and starts logging every subsequent change to a file next to it. The log is
+   * written by a background thread, and is compacted every time the database is saved to the same location
+   * @param filename
+   */
+  void startLog(const std::string& filename);
+
+  /**
+   * @brief stopLog waits until all pending changes are written to the log and stops logging. The log remains valid for the saved database
+   */
+  void stopLog();
+
+  /**
+   * @brief replayLog applies the changes that were logged after the database at the input location was last saved
+   * @param filename
+   * @return the number of changes applied
+   */
+  std::size_t replayLog(const std::string& filename);
+
   /**
    * @brief get returns a ReachRecord message from the database
    * @param id
@@ -94,10 +312,38 @@ public:
   boost::optional<reach_msgs::ReachRecord> get(const std::string& id) const;
 
   /**
-   * @brief put adds a ReachRecord message to the database
+   * @brief get returns a ReachRecord message from the database
+   * @param id
+   * @return
+   */
+  boost::optional<reach_msgs::ReachRecord> get(const std::size_t id) const;
+
+  /**
+   * @brief put adds a ReachRecord message to the database. Throws an exception if the ID of the record is not a non-negative integer, or
+   * if its joint states do not match the joints of the other records of the database
    * @param record
+   * @param interpolated true if the record was estimated from nearby solved records rather than solved directly
+   */
+  void put(const reach_msgs::ReachRecord& record, const bool interpolated = false);
+
+  /**
+   * @brief reserve allocates storage for records with IDs up to n - 1, so that adding them does not need exclusive access to the database
+   * @param n
    */
-  void put(const reach_msgs::ReachRecord& record);
+  void reserve(const std::size_t n);
+
+  /**
+   * @brief isInterpolated
+   * @param id
+   * @return true if the record was estimated from nearby solved records rather than solved directly
+   */
+  bool isInterpolated(const std::string& id) const;
+
+  /**
+   * @brief getInterpolatedIDs
+   * @return the IDs of all records that were interpolated rather than solved directly
+   */
+  std::vector<std::string> getInterpolatedIDs() const;
 
   /**
    * @brief count counts the number of entries in the database
@@ -106,9 +352,68 @@ public:
   std::size_t size() const;
 
   /**
-   * @brief calculateResults calculates the results of the reach study and saves them to internal class members
+   * @brief getIDLimit returns a bound on the IDs of the records of the database: every ID is less than it
+   * @return
+   */
+  std::size_t getIDLimit() const
+  {
+    return capacity_;
+  }
+
+  /**
+   * @brief contains
+   * @param id
+   * @return true if the database contains a record with the input ID
+   */
+  bool contains(const std::size_t id) const;
+
+  /**
+   * @brief getIDAt returns the ID of the record at the input position, where positions range from 0 to size() - 1. Records are assigned
+   * positions in the order in which they are first added to the database, and keep their positions for the lifetime of the database.
+   * The ID of a record is the index of its target point in the reach object point cloud
+   * @param position
+   * @return
+   */
+  std::size_t getIDAt(const std::size_t position) const;
+
+  /**
+   * @brief getPositionOf returns the position of the record with the input ID, if it exists
+   * @param id
+   * @return
+   */
+  boost::optional<std::size_t> getPositionOf(const std::size_t id) const;
+
+  /**
+   * @brief getGoalPosition returns the goal position of a record without creating the full record message. Throws an exception if the
+   * record does not exist
+   * @param id
+   * @return
+   */
+  geometry_msgs::Point getGoalPosition(const std::size_t id) const;
+
+  /**
+   * @brief getVersion returns the version of a record, which changes whenever the record is written or loaded, so that results derived
+   * from its solution can be invalidated. Versions are only comparable within the same database object
+   * @param id
+   * @return 0 if the record does not exist
+   */
+  std::uint64_t getVersion(const std::size_t id) const;
+
+  /**
+   * @brief isReached
+   * @param id
+   * @return true if the record with the input ID exists and was reached
    */
-  void calculateResults();
+  bool isReached(const std::size_t id) const;
+
+  /**
+   * @brief query returns the records that match the input query. Queries that bound or order by score are answered from an index of the
+   * records sorted by score, which is rebuilt by the first such query after the database changes; other queries scan the reached,
+   * interpolated, score and goal columns directly, starting from the lowest ID in range, without creating ReachRecord messages
+   * @param query
+   * @return
+   */
+  std::vector<RecordView> query(const ReachQuery& query) const;
 
   /**
    * @brief printResults prints the calculated results of the reach study to the terminal
@@ -119,10 +424,13 @@ public:
    * @brief getStudyResults
    * @return
    */
-  StudyResults getStudyResults() const
-  {
-    return results_;
-  }
+  StudyResults getStudyResults() const;
+
+  /**
+   * @brief getScoreStatistics returns the current aggregates of the records, without scanning them
+   * @return
+   */
+  ScoreStatistics getScoreStatistics() const;
 
   /**
    * @brief setAverageNeighborsCount
@@ -136,28 +444,159 @@ public:
    */
   void setAverageJointDistance(const float n) {results_.avg_joint_distance = n;}
 
+  /**
+   * @brief setNeighborAnalysis sets the method that computed the average neighbor count and joint distance
+   * @param method "flood_fill" or "components"
+   */
+  void setNeighborAnalysis(const std::string& method) {results_.neighbor_analysis = method;}
+
   // For loops
-  iterator begin()
+  const_iterator begin() const;
+
+  const_iterator end() const;
+
+  reach_msgs::ReachDatabase toReachDatabaseMsg() const;
+
+private:
+
+  /** @brief Number of values stored per goal pose: position (x, y, z) and orientation quaternion (x, y, z, w) */
+  const static std::size_t POSE_SIZE = 7;
+
+  /** @brief Number of lock stripes; the record with ID i is guarded by stripe i % N_STRIPES */
+  const static std::size_t N_STRIPES = 64;
+
+  /** @brief Stripe mutex and the aggregates of the records of the stripe, aligned so that adjacent stripes do not share a cache line */
+  struct alignas(64) Stripe
   {
-    return map_.begin();
-  }
+    std::mutex mutex;
+    ScoreStatistics statistics;
+    /** @brief Log entries of the changes to the records of the stripe, in order, that have not been handed to the log writer yet */
+    std::vector<char> log_entries;
+  };
 
-  iterator end()
+  std::mutex& getStripe(const std::size_t id) const
   {
-    return map_.end();
+    return stripes_[id % N_STRIPES].mutex;
   }
 
-  reach_msgs::ReachDatabase toReachDatabaseMsg();
+  /** @brief Locks every stripe in order, giving exclusive access to the whole database */
+  std::vector<std::unique_lock<std::mutex>> lockAll() const;
 
-private:
+  /** @brief Sets the joints of the database from the first record and grows the arrays to hold the input ID. Requires lockAll() */
+  void prepareHelper(const std::size_t id, const reach_msgs::ReachRecord& record);
+
+  void growHelper(const std::size_t n);
+
+  /** @brief Requires the lock of the stripe of the input ID, and storage for the ID */
+  void putHelper(const std::size_t id, const reach_msgs::ReachRecord& record, const bool interpolated);
+
+  StudyResults getStudyResultsHelper(const ScoreStatistics& statistics) const;
+
+  bool loadColumns(const utils::MappedFilePtr& file);
+
+  bool loadLegacy(const std::string& filename);
 
-  void putHelper(const reach_msgs::ReachRecord& record);
+  /** @brief Returns the contents of an uncompressed database file. Requires lockAll() */
+  std::vector<char> serializeHelper() const;
 
-  std::unordered_map<std::string, reach_msgs::ReachRecord> map_;
+  /** @brief Copies the joint state columns out of the mapped file so that they can be modified. Requires lockAll() */
+  void materializeHelper();
 
-  mutable std::mutex mutex_;
+  const double* getSeedStateHelper(const std::size_t id) const;
+
+  const double* getGoalStateHelper(const std::size_t id) const;
+
+  /** @brief Appends the log entry of the current state of a record to a buffer. Requires the lock of the stripe of the record */
+  void encodeLogEntryHelper(const std::size_t id, std::vector<char>& buffer) const;
+
+  /** @brief Moves the log entries buffered by every stripe to the log queue. Requires lockAll() and log_mutex_ */
+  void queueLogEntriesHelper() const;
+
+  std::size_t replayLogFile(const std::string& filename, const std::uint32_t generation);
+
+  /** @brief Body of the background thread that writes the log */
+  void writeLog() const;
+
+  reach_msgs::ReachRecord getHelper(const std::size_t id) const;
+
+  bool hasHelper(const std::size_t id) const;
+
+  std::size_t nextHelper(std::size_t id) const;
+
+  reach_msgs::ReachDatabase toReachDatabaseHelper() const;
+
+  /** @brief Returns whether the record with the input ID exists and matches the query, and fills its view if so. Requires the lock of the
+   * stripe of the record */
+  bool matchHelper(const std::size_t id, const ReachQuery& query, RecordView& view) const;
+
+  /** @brief Rebuilds the score index if the database changed since it was built. Requires score_index_mutex_ */
+  void updateScoreIndexHelper() const;
+
+  /** @brief Joint names of the seed and goal states of all records */
+  std::vector<std::string> joint_names_;
+
+  /** @brief ID of the record at each position */
+  std::vector<std::size_t> ids_;
+  /** @brief Position of the record with each ID */
+  std::vector<std::size_t> positions_;
+  std::vector<char> reached_;
+  std::vector<char> interpolated_;
+  std::vector<double> scores_;
+  /** @brief POSE_SIZE values per record */
+  std::vector<double> goals_;
+  /** @brief One value per joint per record */
+  std::vector<double> seed_states_;
+  std::vector<double> goal_states_;
+  /** @brief Value of version_ when each record was last written */
+  std::vector<std::uint64_t> versions_;
+
+  mutable std::array<Stripe, N_STRIPES> stripes_;
+  /** @brief Guards appending to the positional index, which is shared by all stripes */
+  mutable std::mutex index_mutex_;
+  /** @brief Size of the arrays and whether the joints are set, which only change while every stripe is locked */
+  std::atomic<std::size_t> capacity_ {0};
+  std::atomic<bool> has_joints_ {false};
+
+  /** @brief File from which the joint state columns are read until they are materialized, with the number of slots in the file */
+  utils::MappedFilePtr mapped_file_;
+  const double* mapped_seed_states_ = nullptr;
+  const double* mapped_goal_states_ = nullptr;
+  std::size_t n_mapped_slots_ = 0;
+  std::atomic<bool> has_mapped_states_ {false};
+
+  StudyCompression compression_;
+
+  /** @brief Number of the last saved snapshot of the database; logs only apply to the snapshot with their generation */
+  mutable std::uint32_t generation_ = 0;
+
+  /** @brief Entries to append to the log, or a request to start a new log file for the snapshot of the input generation */
+  struct LogItem
+  {
+    std::vector<char> entries;
+    bool rotate;
+    std::uint32_t generation;
+  };
+
+  /** @brief Database file of the log, and whether changes are being logged */
+  std::string log_filename_;
+  std::atomic<bool> logging_ {false};
+  std::thread log_thread_;
+  mutable std::mutex log_mutex_;
+  mutable std::condition_variable log_cv_;
+  mutable std::deque<LogItem> log_queue_;
+  mutable bool log_stop_ = false;
+  mutable std::size_t log_rotations_requested_ = 0;
+  mutable std::size_t log_rotations_done_ = 0;
 
   StudyResults results_;
+
+  /** @brief Incremented on every change to the records, to detect when the score index or a record is out of date */
+  std::atomic<std::uint64_t> version_ {0};
+
+  /** @brief Scores and IDs of all records, sorted, and the version of the database when they were collected */
+  mutable std::mutex score_index_mutex_;
+  mutable std::vector<std::pair<double, std::size_t>> score_index_;
+  mutable std::uint64_t score_index_version_ = std::numeric_limits<std::uint64_t>::max();
 };
 typedef std::shared_ptr<ReachDatabase> ReachDatabasePtr;
 
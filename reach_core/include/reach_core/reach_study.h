@@ -17,18 +17,67 @@
 #define REACH_CORE_REACH_STUDY_H
 
 #include <reach_core/study_parameters.h>
+#include <reach_core/capability_map.h>
 #include <reach_core/ik_helper.h>
 #include <reach_core/reach_visualizer.h>
 #include <reach_core/plugins/ik_solver_base.h>
+#include <reach_core/utils/task_pool.h>
 #include <pcl_ros/point_cloud.h>
 #include <pluginlib/class_loader.h>
 #include <sensor_msgs/PointCloud2.h>
+#include <functional>
 
 namespace reach
 {
 namespace core
 {
 
+/**
+ * @brief partitionIntoPhases divides the records of the database into cubic cells with an edge length of twice the neighbor radius.
+ * Optimizing from a point reads that point and writes only to records within the neighbor radius of it, so two points can be optimized
+ * concurrently without conflicts if they are at least two radii apart. Cells whose integer coordinates have the same parity in every
+ * dimension are separated by at least one full cell, so the cells are grouped into 8 phases by their parity, and the cells of a phase
+ * can be processed in parallel
+ * @param db
+ * @param radius
+ * @return the IDs of the records in each cell of each phase
+ */
+std::vector<std::vector<std::vector<std::size_t>>> partitionIntoPhases(const ReachDatabase& db,
+                                                                        const double radius);
+
+/**
+ * @brief matchPoints matches the points of a cloud one-to-one with the points of a previous cloud. Pairs of points closer than the position
+ * tolerance whose normals differ by less than the angle tolerance are matched in order of increasing distance, and each point of either
+ * cloud is matched at most once
+ * @param pool
+ * @param prev_cloud
+ * @param cloud
+ * @param position_tolerance
+ * @param angle_tolerance (radians)
+ * @return the index of the matched previous point for each point of the cloud, or -1 if it is unmatched
+ */
+std::vector<int> matchPoints(utils::TaskPool& pool,
+                             const pcl::PointCloud<pcl::PointNormal>::ConstPtr& prev_cloud,
+                             const pcl::PointCloud<pcl::PointNormal>::ConstPtr& cloud,
+                             const double position_tolerance,
+                             const double angle_tolerance);
+
+/**
+ * @brief prepareOptimization brings the database of an initial study up to date before it is optimized. If verify is set and the database
+ * has interpolated records, verify solves them and the database is saved to the input location. The checkpoint of an interrupted
+ * optimization was made from the unverified records in that case, so it is removed. Otherwise the optimization resumes from the checkpoint
+ * and the changes logged after it, if there is one
+ * @param db
+ * @param db_filename
+ * @param checkpoint_filename
+ * @param verify solves the interpolated records of the database, or empty to skip the verification
+ * @return the number of logged changes recovered if the optimization resumes from the checkpoint
+ */
+boost::optional<std::size_t> prepareOptimization(ReachDatabase& db,
+                                                 const std::string& db_filename,
+                                                 const std::string& checkpoint_filename,
+                                                 const std::function<void()>& verify);
+
 /**
  * @brief The ReachStudy class
  */
@@ -53,9 +102,23 @@ private:
 
   bool initializeStudy();
 
+  bool createSolverPool(const std::size_t n);
+
   bool getReachObjectPointCloud();
 
-  void runInitialReachStudy();
+  void updatePreviousStudy();
+
+  bool loadCapabilityMap();
+
+  void updateNeighborGraph();
+
+  bool runInitialReachStudy();
+
+  void solveBatch(const std::vector<std::size_t>& indices,
+                  const std::vector<std::vector<double>>& seeds,
+                  const reach::plugins::IKSolverBasePtr& ik_solver);
+
+  void verifyInterpolatedRecords();
 
   void optimizeReachStudyResults();
 
@@ -66,6 +129,8 @@ private:
   ros::NodeHandle nh_;
   
   StudyParameters sp_;
+
+  std::unique_ptr<utils::TaskPool> pool_;
   
   pcl::PointCloud<pcl::PointNormal>::Ptr cloud_;
   
@@ -75,11 +140,21 @@ private:
   pluginlib::ClassLoader<reach::plugins::IKSolverBase> solver_loader_;
   pluginlib::ClassLoader<reach::plugins::DisplayBase> display_loader_;
   reach::plugins::IKSolverBasePtr ik_solver_;
+  std::vector<reach::plugins::IKSolverBasePtr> solver_pool_;
   reach::plugins::DisplayBasePtr display_;
   
   ReachVisualizerPtr visualizer_;
 
-  SearchTreePtr search_tree_;
+  SpatialIndexPtr spatial_index_;
+
+  NeighborGraphPtr neighbor_graph_;
+
+  TransitionCachePtr transition_cache_;
+
+  CapabilityMapPtr capability_map_;
+
+  /** @brief IDs of the points whose neighborhoods should be revisited by the optimization; empty revisits all points */
+  std::vector<std::size_t> revisit_;
   
   std::string dir_;
   
@@ -40,16 +40,24 @@ public:
    * @param solver
    * @param display
    * @param neighbor_radius
-   * @param search_tree
+   * @param spatial_index index of the records of the database, which the visualizer updates with the database
    */
   ReachVisualizer(ReachDatabasePtr db,
                   reach::plugins::IKSolverBasePtr solver,
                   reach::plugins::DisplayBasePtr display,
                   const double neighbor_radius,
-                  SearchTreePtr search_tree = nullptr);
+                  SpatialIndexPtr spatial_index = nullptr,
+                  TransitionCachePtr transition_cache = nullptr);
 
   void update();
 
+  /**
+   * @brief setNeighborGraph sets the precomputed neighbor graph of the database, which the neighbor callbacks use instead of searching
+   * the spatial index. The graph is ignored if it was built with a different radius
+   * @param neighbor_graph
+   */
+  void setNeighborGraph(NeighborGraphPtr neighbor_graph);
+
 private:
 
   void reSolveIKCB(const visualization_msgs::InteractiveMarkerFeedbackConstPtr& fb);
@@ -68,7 +76,12 @@ private:
 
   reach::plugins::DisplayBasePtr display_;
 
-  SearchTreePtr search_tree_;
+  SpatialIndexPtr spatial_index_;
+
+  TransitionCachePtr transition_cache_;
+
+  /** @brief Accessed atomically, since the graph is replaced by the study while the callbacks may run */
+  NeighborGraphPtr neighbor_graph_;
 
   double neighbor_radius_;
 };
@@ -0,0 +1,139 @@
+/*
+ * Copyright 2019 Southwest Research Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef REACH_CORE_SPATIAL_INDEX_H
+#define REACH_CORE_SPATIAL_INDEX_H
+
+#include <reach_core/reach_database.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace reach
+{
+namespace core
+{
+
+/**
+ * @brief The SpatialIndex class finds the records of a database whose goal positions lie within a radius of a point. The index holds its
+ * own copy of the goal positions, so it must be updated after records are added to the database; since records keep their positions in
+ * the database, an update only indexes the records added since the previous one. The goal position of a record (i.e. the position of its
+ * target point) is assumed not to change once it is indexed
+ *
+ * Searches are answered from an immutable snapshot of the index, which update() replaces, so searches can run concurrently with each
+ * other and with an update
+ */
+class SpatialIndex
+{
+public:
+
+  virtual ~SpatialIndex() = default;
+
+  /**
+   * @brief update indexes the records added to the database since the previous update
+   * @param db
+   */
+  void update(const ReachDatabase& db);
+
+  /**
+   * @brief radiusSearch returns the IDs of the indexed records whose goal positions lie within the radius of the input point, in no
+   * particular order
+   * @param pt
+   * @param radius
+   * @return
+   */
+  std::vector<std::size_t> radiusSearch(const geometry_msgs::Point& pt,
+                                        const double radius) const;
+
+  /** @brief Immutable search structure over the indexed positions, implemented by each type of index */
+  class Snapshot
+  {
+  public:
+
+    virtual ~Snapshot() = default;
+
+    /** @brief Appends the IDs of the points within the radius of the input point (x, y, z) */
+    virtual void radiusSearch(const double* pt,
+                              const double radius,
+                              std::vector<std::size_t>& ids) const = 0;
+  };
+  typedef std::shared_ptr<const Snapshot> SnapshotPtr;
+
+protected:
+
+  /**
+   * @brief build creates a search structure over the input points
+   * @param ids ID of each point
+   * @param points x, y and z of each point
+   * @return
+   */
+  virtual SnapshotPtr build(const std::vector<std::size_t>& ids,
+                            const std::vector<double>& points) const = 0;
+
+private:
+
+  /** @brief Guards the indexed points; the snapshot is exchanged atomically */
+  std::mutex update_mutex_;
+  std::vector<std::size_t> ids_;
+  std::vector<double> points_;
+  SnapshotPtr snapshot_;
+};
+typedef std::shared_ptr<SpatialIndex> SpatialIndexPtr;
+
+/**
+ * @brief The KdTreeIndex class indexes the positions in a FLANN k-d tree, which is rebuilt on every update
+ */
+class KdTreeIndex : public SpatialIndex
+{
+protected:
+
+  SnapshotPtr build(const std::vector<std::size_t>& ids,
+                    const std::vector<double>& points) const override;
+};
+
+/**
+ * @brief The GridIndex class hashes the positions into cubic cells. With cells as large as the search radius, a search only visits the 27
+ * cells around the query point, and rebuilding the grid is linear in the number of points
+ */
+class GridIndex : public SpatialIndex
+{
+public:
+
+  explicit GridIndex(const double cell_size);
+
+protected:
+
+  SnapshotPtr build(const std::vector<std::size_t>& ids,
+                    const std::vector<double>& points) const override;
+
+private:
+
+  double cell_size_;
+};
+
+/**
+ * @brief makeSpatialIndex creates a spatial index by name
+ * @param type "kdtree" or "grid"
+ * @param radius typical search radius, which sets the cell size of a grid
+ * @return nullptr if the type is unknown
+ */
+SpatialIndexPtr makeSpatialIndex(const std::string& type,
+                                 const double radius);
+
+} // namespace core
+} // namespace reach
+
+#endif // REACH_CORE_SPATIAL_INDEX_H
@@ -35,6 +35,8 @@ struct StudyResults
   float reach_percentage = 0.0f;
   float avg_num_neighbors = 0.0f;
   float avg_joint_distance = 0.0f;
+  /** @brief Method that computed the neighbor metrics ("flood_fill" or "components"), or empty if they were not computed */
+  std::string neighbor_analysis;
 };
 
 struct StudyOptimization
@@ -42,6 +44,70 @@ struct StudyOptimization
   int max_steps;
   float step_improvement_threshold;
   float radius;
+  /** @brief Type of the index used to find the neighbors of a point: "kdtree" or "grid" (with cells the size of the radius) */
+  std::string spatial_index = "kdtree";
+  /** @brief Maximum number of cached neighbor IK transitions; 0 disables the cache */
+  int transition_cache_size = 100000;
+};
+
+/**
+ * @brief The StudyAdaptiveSampling struct contains the parameters of the coarse-to-fine sampling mode of the initial reach study, in which
+ * only one representative point per voxel of the cloud is solved at first, and the remaining points are only solved in voxels near the
+ * boundary between reachable and unreachable regions or with widely varying scores. The points of all other voxels are labeled by
+ * interpolating the results of the surrounding representatives
+ */
+struct StudyAdaptiveSampling
+{
+  bool enable = false;
+  /** @brief Edge length of the voxels; 0 uses the optimization radius */
+  float voxel_size = 0.0f;
+  /** @brief Maximum standard deviation of the representative scores around a voxel, relative to their mean, for it to be interpolated */
+  float score_deviation_threshold = 0.1f;
+  /** @brief Solve the interpolated points directly once the study is otherwise complete */
+  bool verify_interpolated = false;
+};
+
+/**
+ * @brief The StudyIncremental struct contains the parameters for updating the results of a previous study when the reach object point
+ * cloud changes. Points of the new cloud that match a point of the previous study in position and normal within the tolerances keep the
+ * previous results; only new or moved points are solved
+ */
+struct StudyIncremental
+{
+  bool enable = false;
+  /** @brief Maximum distance (m) between matching points */
+  float position_tolerance = 0.001f;
+  /** @brief Maximum angle (rad) between the normals of matching points */
+  float angle_tolerance = 0.0175f;
+};
+
+/**
+ * @brief The StudyCapabilityMap struct contains the parameters of the capability map of the robot workspace, which is used to skip IK for
+ * points that the robot cannot reach and to solve the points with the most reachable orientations first
+ */
+struct StudyCapabilityMap
+{
+  bool enable = false;
+  /** @brief Edge length (m) of the voxels of the map */
+  float resolution = 0.05f;
+  /** @brief Number of robot configurations sampled to build the map */
+  int n_samples = 1000000;
+};
+
+/**
+ * @brief The StudyCompression struct contains the parameters of the compressed encoding of saved reach study databases. Goal positions,
+ * goal orientations (quaternion components) and joint positions are rounded to the given resolutions, so loaded values differ from the
+ * saved ones by at most half of the resolution; all other fields are stored exactly
+ */
+struct StudyCompression
+{
+  bool enable = false;
+  /** @brief Resolution (m) of the goal positions */
+  double position_resolution = 1.0e-5;
+  /** @brief Resolution of the components of the goal orientation quaternions */
+  double orientation_resolution = 1.0e-6;
+  /** @brief Resolution (rad or m) of the joint positions */
+  double joint_resolution = 1.0e-5;
 };
 
 /**
@@ -57,9 +123,22 @@ struct StudyParameters
   std::string pcd_filename;
   bool visualize_results;
   bool get_neighbors;
+  /**
+   * @brief Method of the average neighbor count calculation: "flood_fill" flood fills the region reachable from every reached record,
+   * or "components" solves each neighbor edge once and measures the joint-space-continuous components (see ComponentAnalysis). The
+   * stored averages of the two methods have different definitions and are not comparable
+   */
+  std::string neighbor_analysis = "flood_fill";
   std::vector<std::string> compare_dbs;
   std::string fixed_frame;
   std::string object_frame;
+  int max_threads = 0;
+  double checkpoint_interval = 60.0;
+  bool neighbor_seeding = false;
+  StudyAdaptiveSampling adaptive_sampling;
+  StudyIncremental incremental;
+  StudyCapabilityMap capability_map;
+  StudyCompression compression;
 };
 
 } // namespace core
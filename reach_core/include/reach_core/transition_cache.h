@@ -0,0 +1,158 @@
+/*
+ * Copyright 2019 Southwest Research Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef REACH_CORE_TRANSITION_CACHE_H
+#define REACH_CORE_TRANSITION_CACHE_H
+
+#include <geometry_msgs/Pose.h>
+#include <boost/optional.hpp>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace reach
+{
+namespace core
+{
+
+/**
+ * @brief The TransitionCache class stores the results of solving IK for the target of a record seeded with the solution of a neighboring
+ * record, so that repeated neighbor searches (optimization passes, neighbor counting, interactive exploration) do not call the solver again.
+ * Entries are keyed by the source record, the version of the source record and the target record. An entry whose source record has since
+ * changed is stale and is dropped when it is looked up; the seed and target pose are also checked, so the results are only reused for the
+ * exact same IK problem. The cache is split into shards with their own locks and least recently used eviction, and holds at most a fixed
+ * number of entries. The results depend on the solver, so a cache must only be used with one solver configuration and one database
+ */
+class TransitionCache
+{
+public:
+
+  /**
+   * @brief The Transition struct is the result of solving IK for a target from a seed
+   */
+  struct Transition
+  {
+    /** @brief Score of the solution; uninitialized if no solution was found */
+    boost::optional<double> score;
+    /** @brief Solution, ordered as the joints of the solver */
+    std::vector<double> solution;
+  };
+
+  /**
+   * @brief TransitionCache
+   * @param capacity maximum number of entries
+   * @param n_shards maximum number of independently locked parts of the cache; small caches use fewer
+   */
+  explicit TransitionCache(const std::size_t capacity,
+                           const std::size_t n_shards = 64);
+
+  /**
+   * @brief find looks up the result of a transition
+   * @param source ID of the record whose solution is the seed
+   * @param version version of the source record when its solution was read
+   * @param target ID of the target record
+   * @param seed
+   * @param target_pose
+   * @param transition
+   * @return false if the transition is not cached
+   */
+  bool find(const std::size_t source,
+            const std::uint64_t version,
+            const std::size_t target,
+            const std::vector<double>& seed,
+            const geometry_msgs::Pose& target_pose,
+            Transition& transition);
+
+  /**
+   * @brief insert stores the result of a transition, replacing any previous result for the same source and target records
+   */
+  void insert(const std::size_t source,
+              const std::uint64_t version,
+              const std::size_t target,
+              const std::vector<double>& seed,
+              const geometry_msgs::Pose& target_pose,
+              const Transition& transition);
+
+  void clear();
+
+  /**
+   * @brief size returns the number of cached transitions
+   * @return
+   */
+  std::size_t size() const;
+
+  std::size_t getHits() const
+  {
+    return hits_;
+  }
+
+  std::size_t getMisses() const
+  {
+    return misses_;
+  }
+
+private:
+
+  struct Key
+  {
+    std::size_t source;
+    std::size_t target;
+
+    bool operator==(const Key& other) const
+    {
+      return source == other.source && target == other.target;
+    }
+  };
+
+  struct KeyHash
+  {
+    std::size_t operator()(const Key& key) const;
+  };
+
+  struct Entry
+  {
+    Key key;
+    std::uint64_t version;
+    std::vector<double> seed;
+    geometry_msgs::Pose target_pose;
+    Transition transition;
+  };
+
+  /** @brief Entries ordered from the most to the least recently used, and their positions by key */
+  struct Shard
+  {
+    std::mutex mutex;
+    std::list<Entry> entries;
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+  };
+
+  Shard& getShard(const Key& key);
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+  std::size_t shard_capacity_;
+
+  std::atomic<std::size_t> hits_ {0};
+  std::atomic<std::size_t> misses_ {0};
+};
+typedef std::shared_ptr<TransitionCache> TransitionCachePtr;
+
+} // namespace core
+} // namespace reach
+
+#endif // REACH_CORE_TRANSITION_CACHE_H
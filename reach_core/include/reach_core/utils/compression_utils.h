@@ -0,0 +1,86 @@
+/*
+ * Copyright 2019 Southwest Research Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef REACH_UTILS_COMPRESSION_UTILS_H
+#define REACH_UTILS_COMPRESSION_UTILS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace reach
+{
+namespace utils
+{
+
+/**
+ * @brief compress compresses the input data with LZ4. The output starts with the uint64 size of the input, so that it can be decompressed
+ * without knowing the size in advance. Throws an exception if the input is too large for LZ4
+ * @param data
+ * @param size
+ * @return
+ */
+std::vector<char> compress(const char* data,
+                           const std::size_t size);
+
+/**
+ * @brief decompress decompresses data produced by compress
+ * @param data
+ * @param size
+ * @param out
+ * @return false if the data is corrupt
+ */
+bool decompress(const char* data,
+                const std::size_t size,
+                std::vector<char>& out);
+
+/**
+ * @brief shuffleBytes transposes an array of elements of the input size such that the first bytes of all elements come first, then the
+ * second bytes, and so on. Neighboring numbers usually share their high-order bytes, so the shuffled array compresses much better
+ * @param in
+ * @param n number of elements
+ * @param element_size
+ * @param out must not overlap the input
+ */
+void shuffleBytes(const char* in,
+                  const std::size_t n,
+                  const std::size_t element_size,
+                  char* out);
+
+/**
+ * @brief unshuffleBytes reverses shuffleBytes
+ */
+void unshuffleBytes(const char* in,
+                    const std::size_t n,
+                    const std::size_t element_size,
+                    char* out);
+
+/**
+ * @brief zigZagEncode maps signed integers of small magnitude to unsigned integers of small magnitude
+ */
+inline std::uint64_t zigZagEncode(const std::int64_t v)
+{
+  return (static_cast<std::uint64_t>(v) << 1) ^ static_cast<std::uint64_t>(v >> 63);
+}
+
+inline std::int64_t zigZagDecode(const std::uint64_t v)
+{
+  return static_cast<std::int64_t>(v >> 1) ^ -static_cast<std::int64_t>(v & 1);
+}
+
+} // namespace utils
+} // namespace reach
+
+#endif // REACH_UTILS_COMPRESSION_UTILS_H
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2019 Southwest Research Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef REACH_UTILS_MAPPED_FILE_H
+#define REACH_UTILS_MAPPED_FILE_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace reach
+{
+namespace utils
+{
+
+/**
+ * @brief The MappedFile class maps a file into memory for reading. The operating system only reads the pages of the file that are
+ * accessed, so large files can be opened without reading them in full. The mapping stays valid until the object is destroyed, even if
+ * the file is replaced or removed in the meantime
+ */
+class MappedFile
+{
+public:
+
+  /**
+   * @brief open maps the file at the input location
+   * @param path
+   * @return nullptr if the file cannot be opened or is empty
+   */
+  static std::shared_ptr<const MappedFile> open(const std::string& path);
+
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* data() const
+  {
+    return data_;
+  }
+
+  std::size_t size() const
+  {
+    return size_;
+  }
+
+private:
+
+  MappedFile(const char* data, const std::size_t size);
+
+  const char* data_;
+  std::size_t size_;
+};
+typedef std::shared_ptr<const MappedFile> MappedFilePtr;
+
+} // namespace utils
+} // namespace reach
+
+#endif // REACH_UTILS_MAPPED_FILE_H
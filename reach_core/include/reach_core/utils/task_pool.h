@@ -0,0 +1,132 @@
+/*
+ * Copyright 2019 Southwest Research Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef REACH_UTILS_TASK_POOL_H
+#define REACH_UTILS_TASK_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace reach
+{
+namespace utils
+{
+
+/**
+ * @brief The TaskPool class executes tasks on a fixed set of worker threads using work stealing. Each worker owns a queue of tasks
+ * which it executes in order from the front; workers that run out of tasks steal from the back of the other workers' queues, so that
+ * tasks of very uneven cost (e.g. reachable vs. unreachable IK targets) do not leave threads idle at the end of a batch
+ */
+class TaskPool
+{
+public:
+
+  /**
+   * @brief A task receives the index of the worker executing it, which can be used to access per-worker resources
+   */
+  typedef std::function<void(const std::size_t worker)> Task;
+
+  /**
+   * @brief TaskPool
+   * @param n_threads number of worker threads; 0 uses the number of hardware threads
+   */
+  explicit TaskPool(const std::size_t n_threads = 0);
+
+  ~TaskPool();
+
+  TaskPool(const TaskPool&) = delete;
+  TaskPool& operator=(const TaskPool&) = delete;
+
+  /**
+   * @brief size returns the number of worker threads
+   * @return
+   */
+  std::size_t size() const
+  {
+    return queues_.size();
+  }
+
+  /**
+   * @brief submit adds a task to the pool. Tasks submitted from a worker thread are added to that worker's own queue
+   * @param task
+   */
+  void submit(Task task);
+
+  /**
+   * @brief wait blocks until all submitted tasks have finished; rethrows the first exception thrown by a task, if any. Must not be
+   * called from a worker thread
+   */
+  void wait();
+
+  /**
+   * @brief parallelFor creates one task per index in [0, n), distributes contiguous blocks of them across the workers, and waits for
+   * all of them to finish. Must not be called from a worker thread
+   * @param n
+   * @param fn function invoked with the index and the worker index
+   */
+  void parallelFor(const std::size_t n,
+                   const std::function<void(const std::size_t i, const std::size_t worker)>& fn);
+
+private:
+
+  struct Queue
+  {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  void work(const std::size_t id);
+
+  bool pop(const std::size_t id, Task& task);
+
+  bool steal(const std::size_t id, Task& task);
+
+  void push(const std::size_t id, Task task);
+
+  void finish();
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+
+  std::vector<std::thread> threads_;
+
+  /** @brief Number of tasks sitting in queues */
+  std::atomic<std::size_t> queued_;
+
+  /** @brief Number of tasks submitted but not yet finished */
+  std::atomic<std::size_t> pending_;
+
+  std::atomic<std::size_t> next_queue_;
+
+  bool stop_;
+
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_cv_;
+
+  std::mutex done_mutex_;
+  std::condition_variable done_cv_;
+  std::exception_ptr exception_;
+};
+
+} // namespace utils
+} // namespace reach
+
+#endif // REACH_UTILS_TASK_POOL_H
@@ -0,0 +1,234 @@
+/*
+ * Copyright 2019 Southwest Research Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <reach_core/capability_map.h>
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <cmath>
+#include <fstream>
+
+namespace
+{
+
+const static char FILE_MAGIC[8] = {'R', 'E', 'A', 'C', 'H', 'C', 'A', 'P'};
+const static std::uint32_t FILE_VERSION = 1;
+
+/** @brief Number of samples generated per task while building the map */
+const static std::size_t SAMPLE_BATCH_SIZE = 1000;
+
+/** @brief The approach direction is binned by the cell of a 3x3 grid on the face of the unit cube through which it passes */
+const static int N_FACE_CELLS = 3;
+const static int N_ORIENTATION_BINS = 6 * N_FACE_CELLS * N_FACE_CELLS;
+
+/** @brief Voxel coordinates are packed into 21 bits each */
+const static long KEY_OFFSET = 1L << 20;
+
+int getOrientationBin(const Eigen::Vector3d& dir)
+{
+  int axis;
+  const double major = dir.cwiseAbs().maxCoeff(&axis);
+  const int face = 2 * axis + (dir(axis) < 0.0 ? 1 : 0);
+
+  // Coordinates of the intersection with the face, in [-1, 1]
+  const double u = dir((axis + 1) % 3) / major;
+  const double v = dir((axis + 2) % 3) / major;
+
+  auto toCell = [](const double c) {
+    return std::min(N_FACE_CELLS - 1, static_cast<int>((c + 1.0) / 2.0 * N_FACE_CELLS));
+  };
+
+  return face * N_FACE_CELLS * N_FACE_CELLS + toCell(u) * N_FACE_CELLS + toCell(v);
+}
+
+} // namespace anonymous
+
+namespace reach
+{
+namespace core
+{
+
+CapabilityMap::CapabilityMap(const double resolution)
+  : resolution_(resolution)
+{
+
+}
+
+bool CapabilityMap::build(utils::TaskPool& pool,
+                          const std::vector<plugins::IKSolverBasePtr>& solvers,
+                          const std::size_t n_samples)
+{
+  // Each worker collects a bit mask of the orientation bins reached in each voxel
+  std::vector<std::unordered_map<std::int64_t, std::uint64_t>> worker_masks (pool.size());
+  std::atomic<bool> supported {true};
+
+  const std::size_t n_batches = (n_samples + SAMPLE_BATCH_SIZE - 1) / SAMPLE_BATCH_SIZE;
+  pool.parallelFor(n_batches, [&](const std::size_t b, const std::size_t worker)
+  {
+    if(!supported)
+    {
+      return;
+    }
+
+    plugins::IsometryVector poses;
+    if(!solvers[worker]->samplePoses(std::min(SAMPLE_BATCH_SIZE, n_samples - b * SAMPLE_BATCH_SIZE), poses))
+    {
+      supported = false;
+      return;
+    }
+
+    for(const Eigen::Isometry3d& pose : poses)
+    {
+      const Eigen::Vector3d& t = pose.translation();
+      const std::int64_t key = getKey(static_cast<long>(std::floor(t.x() / resolution_)),
+                                      static_cast<long>(std::floor(t.y() / resolution_)),
+                                      static_cast<long>(std::floor(t.z() / resolution_)));
+      worker_masks[worker][key] |= std::uint64_t(1) << getOrientationBin(pose.linear().col(2));
+    }
+  });
+
+  if(!supported)
+  {
+    return false;
+  }
+
+  std::unordered_map<std::int64_t, std::uint64_t> masks;
+  for(const auto& m : worker_masks)
+  {
+    for(const auto& pair : m)
+    {
+      masks[pair.first] |= pair.second;
+    }
+  }
+
+  map_.clear();
+  for(const auto& pair : masks)
+  {
+    map_.emplace(pair.first, static_cast<float>(std::bitset<64>(pair.second).count()) / N_ORIENTATION_BINS);
+  }
+
+  return true;
+}
+
+bool CapabilityMap::save(const std::string& filename,
+                         const std::string& key) const
+{
+  std::ofstream file (filename.c_str(), std::ios::out | std::ios::binary);
+  if(!file)
+  {
+    return false;
+  }
+
+  const std::uint64_t key_size = key.size();
+  const std::uint64_t n = map_.size();
+
+  file.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+  file.write(reinterpret_cast<const char*>(&FILE_VERSION), sizeof(FILE_VERSION));
+  file.write(reinterpret_cast<const char*>(&key_size), sizeof(key_size));
+  file.write(key.data(), key.size());
+  file.write(reinterpret_cast<const char*>(&resolution_), sizeof(resolution_));
+  file.write(reinterpret_cast<const char*>(&n), sizeof(n));
+  for(const auto& pair : map_)
+  {
+    file.write(reinterpret_cast<const char*>(&pair.first), sizeof(pair.first));
+    file.write(reinterpret_cast<const char*>(&pair.second), sizeof(pair.second));
+  }
+
+  return file.good();
+}
+
+bool CapabilityMap::load(const std::string& filename,
+                         const std::string& key)
+{
+  std::ifstream file (filename.c_str(), std::ios::in | std::ios::binary);
+  if(!file)
+  {
+    return false;
+  }
+
+  char magic[sizeof(FILE_MAGIC)];
+  std::uint32_t version;
+  std::uint64_t key_size;
+  file.read(magic, sizeof(magic));
+  file.read(reinterpret_cast<char*>(&version), sizeof(version));
+  file.read(reinterpret_cast<char*>(&key_size), sizeof(key_size));
+  if(!file || !std::equal(magic, magic + sizeof(magic), FILE_MAGIC) || version != FILE_VERSION || key_size != key.size())
+  {
+    return false;
+  }
+
+  std::string file_key (key_size, '\0');
+  double resolution;
+  std::uint64_t n;
+  file.read(&file_key[0], key_size);
+  file.read(reinterpret_cast<char*>(&resolution), sizeof(resolution));
+  file.read(reinterpret_cast<char*>(&n), sizeof(n));
+  if(!file || file_key != key || resolution != resolution_)
+  {
+    return false;
+  }
+
+  std::unordered_map<std::int64_t, float> map;
+  map.reserve(n);
+  for(std::uint64_t i = 0; i < n; ++i)
+  {
+    std::int64_t k;
+    float value;
+    file.read(reinterpret_cast<char*>(&k), sizeof(k));
+    file.read(reinterpret_cast<char*>(&value), sizeof(value));
+    map.emplace(k, value);
+  }
+
+  if(!file)
+  {
+    return false;
+  }
+
+  map_ = std::move(map);
+  return true;
+}
+
+float CapabilityMap::getReachability(const Eigen::Vector3d& position) const
+{
+  const long x = static_cast<long>(std::floor(position.x() / resolution_));
+  const long y = static_cast<long>(std::floor(position.y() / resolution_));
+  const long z = static_cast<long>(std::floor(position.z() / resolution_));
+
+  float reachability = 0.0f;
+  for(long dx = -1; dx <= 1; ++dx)
+  {
+    for(long dy = -1; dy <= 1; ++dy)
+    {
+      for(long dz = -1; dz <= 1; ++dz)
+      {
+        auto it = map_.find(getKey(x + dx, y + dy, z + dz));
+        if(it != map_.end())
+        {
+          reachability = std::max(reachability, it->second);
+        }
+      }
+    }
+  }
+
+  return reachability;
+}
+
+std::int64_t CapabilityMap::getKey(const long x, const long y, const long z) const
+{
+  return ((x + KEY_OFFSET) << 42) | ((y + KEY_OFFSET) << 21) | (z + KEY_OFFSET);
+}
+
+} // namespace core
+} // namespace reach
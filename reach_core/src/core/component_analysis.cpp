@@ -0,0 +1,216 @@
+/*
+ * Copyright 2019 Southwest Research Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <reach_core/component_analysis.h>
+#include <reach_core/ik_helper.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <stdexcept>
+
+namespace
+{
+
+/** @brief Number of records whose outgoing edges are solved per task */
+const static std::size_t BATCH_SIZE = 64;
+
+} // namespace anonymous
+
+namespace reach
+{
+namespace core
+{
+
+void ComponentAnalysis::run(utils::TaskPool& pool,
+                            const std::vector<reach::plugins::IKSolverBasePtr>& solvers,
+                            const ReachDatabase& db,
+                            const NeighborGraph& graph,
+                            TransitionCachePtr cache)
+{
+  if(solvers.size() < pool.size())
+  {
+    throw std::invalid_argument("A solver is required for each worker of the pool");
+  }
+
+  ReachQuery query;
+  query.reached = true;
+  const std::vector<RecordView> reached = db.query(query);
+
+  const std::size_t n_ids = std::max<std::size_t>(db.getIDLimit(), reached.empty() ? 0 : reached.back().id + 1);
+  if(n_ids > std::numeric_limits<std::uint32_t>::max())
+  {
+    throw std::runtime_error("Record IDs are too large for the component analysis");
+  }
+
+  std::vector<char> is_reached (n_ids, 0);
+  for(const RecordView& view : reached)
+  {
+    is_reached[view.id] = 1;
+  }
+
+  parents_ = std::vector<std::atomic<std::uint32_t>>(n_ids);
+  for(std::size_t id = 0; id < n_ids; ++id)
+  {
+    parents_[id].store(static_cast<std::uint32_t>(id), std::memory_order_relaxed);
+  }
+
+  // Solve each edge between reached records once, from the record with the lower ID to the one with the higher ID, seeded with the
+  // solution of the former
+  const std::vector<std::string> joint_names = solvers.front()->getJointNames();
+  std::vector<double> joint_distances (pool.size(), 0.0);
+  std::vector<std::size_t> transitions (pool.size(), 0);
+  const std::size_t n_batches = (reached.size() + BATCH_SIZE - 1) / BATCH_SIZE;
+  pool.parallelFor(n_batches, [&](const std::size_t b, const std::size_t worker)
+  {
+    for(std::size_t i = b * BATCH_SIZE; i < std::min(reached.size(), (b + 1) * BATCH_SIZE); ++i)
+    {
+      const std::size_t id = reached[i].id;
+
+      std::vector<std::uint32_t> targets;
+      for(const std::uint32_t neighbor : graph.getNeighbors(id))
+      {
+        if(neighbor > id && neighbor < n_ids && is_reached[neighbor])
+        {
+          targets.push_back(neighbor);
+        }
+      }
+
+      const boost::optional<reach_msgs::ReachRecord> rec = db.get(id);
+      if(targets.empty() || !rec)
+      {
+        continue;
+      }
+
+      const std::map<std::string, double> solution = jointStateMsgToMap(rec->goal_state);
+      std::vector<double> seed (joint_names.size());
+      for(std::size_t j = 0; j < joint_names.size(); ++j)
+      {
+        seed[j] = solution.at(joint_names[j]);
+      }
+
+      std::vector<reach_msgs::ReachRecord> neighbors;
+      std::vector<std::uint32_t> solved_targets;
+      for(const std::uint32_t target : targets)
+      {
+        boost::optional<reach_msgs::ReachRecord> neighbor = db.get(target);
+        if(neighbor)
+        {
+          neighbors.push_back(std::move(*neighbor));
+          solved_targets.push_back(target);
+        }
+      }
+
+      std::vector<std::vector<double>> solutions;
+      std::vector<boost::optional<double>> scores;
+      solveTransitions(solvers[worker], id, db.getVersion(id), seed, neighbors, solutions, scores, cache);
+
+      for(std::size_t j = 0; j < solved_targets.size(); ++j)
+      {
+        if(scores[j])
+        {
+          for(std::size_t k = 0; k < seed.size(); ++k)
+          {
+            joint_distances[worker] += std::abs(solutions[j][k] - seed[k]);
+          }
+          ++transitions[worker];
+          unite(static_cast<std::uint32_t>(id), solved_targets[j]);
+        }
+      }
+    }
+  });
+
+  // Count the records of each component
+  std::map<std::uint32_t, std::size_t> sizes;
+  for(const RecordView& view : reached)
+  {
+    ++sizes[find(static_cast<std::uint32_t>(view.id))];
+  }
+
+  component_sizes_.clear();
+  std::size_t connected_count = 0;
+  for(const std::pair<const std::uint32_t, std::size_t>& size : sizes)
+  {
+    component_sizes_.push_back(size.second);
+    connected_count += size.second * (size.second - 1);
+  }
+  std::sort(component_sizes_.begin(), component_sizes_.end(), std::greater<std::size_t>());
+
+  double joint_distance = 0.0;
+  n_transitions_ = 0;
+  for(std::size_t w = 0; w < pool.size(); ++w)
+  {
+    joint_distance += joint_distances[w];
+    n_transitions_ += transitions[w];
+  }
+
+  avg_connected_count_ = db.size() > 0 ? static_cast<float>(connected_count) / static_cast<float>(db.size()) : 0.0f;
+  avg_edge_joint_distance_ = n_transitions_ > 0 ? static_cast<float>(joint_distance / static_cast<double>(n_transitions_)) : 0.0f;
+}
+
+std::size_t ComponentAnalysis::getComponent(const std::size_t id) const
+{
+  return id < parents_.size() ? find(static_cast<std::uint32_t>(id)) : id;
+}
+
+std::uint32_t ComponentAnalysis::find(std::uint32_t id) const
+{
+  // Path halving: point each visited ID at its grandparent. A failed exchange means another thread already changed the parent, which
+  // only ever moves it closer to the root
+  while(true)
+  {
+    std::uint32_t parent = parents_[id].load();
+    if(parent == id)
+    {
+      return id;
+    }
+
+    const std::uint32_t grandparent = parents_[parent].load();
+    if(parent != grandparent)
+    {
+      parents_[id].compare_exchange_weak(parent, grandparent);
+    }
+    id = grandparent;
+  }
+}
+
+void ComponentAnalysis::unite(std::uint32_t a,
+                              std::uint32_t b)
+{
+  // Always link the root with the higher ID below the one with the lower ID, so concurrent links cannot form a cycle
+  while(true)
+  {
+    a = find(a);
+    b = find(b);
+    if(a == b)
+    {
+      return;
+    }
+
+    if(a < b)
+    {
+      std::swap(a, b);
+    }
+
+    std::uint32_t expected = a;
+    if(parents_[a].compare_exchange_strong(expected, b))
+    {
+      return;
+    }
+  }
+}
+
+} // namespace core
+} // namespace reach
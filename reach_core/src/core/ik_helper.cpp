@@ -15,64 +15,314 @@
  */
 #include <eigen_conversions/eigen_msg.h>
 #include <reach_core/ik_helper.h>
+#include <atomic>
+#include <stdexcept>
 
 namespace reach
 {
 namespace core
 {
 
-std::vector<reach_msgs::ReachRecord> getNeighbors(const reach_msgs::ReachRecord& rec,
-                                                  const ReachDatabasePtr db,
-                                                  const double radius)
+namespace
 {
-  const float x = rec.goal.position.x;
-  const float y = rec.goal.position.y;
-  const float z = rec.goal.position.z;
 
-  // Create vectors for storing poses and reach record messages that lie within radius of current point
-  std::vector<reach_msgs::ReachRecord> reach_records;
+/**
+ * @brief getNeighborIDs returns the IDs of the records whose goal positions lie within the radius of a point, which may include the
+ * record at the point itself
+ */
+std::vector<std::size_t> getNeighborIDs(const std::size_t id,
+                                        const geometry_msgs::Point& pt,
+                                        const ReachDatabase& db,
+                                        const double radius,
+                                        const SpatialIndexPtr& spatial_index,
+                                        const NeighborGraphPtr& neighbor_graph)
+{
+  std::vector<std::size_t> ids;
+  if(neighbor_graph && neighbor_graph->hasRadius(radius))
+  {
+    const NeighborGraph::Neighbors neighbors = neighbor_graph->getNeighbors(id);
+    ids.assign(neighbors.begin(), neighbors.end());
+  }
+  else if(spatial_index)
+  {
+    ids = spatial_index->radiusSearch(pt, radius);
+  }
+  else
+  {
+    // Select the records in the bounding box of the neighborhood without creating their messages, then keep those within the radius
+    ReachQuery query;
+    query.box = ReachQuery::Box();
+    query.box->min.x = pt.x - radius;
+    query.box->min.y = pt.y - radius;
+    query.box->min.z = pt.z - radius;
+    query.box->max.x = pt.x + radius;
+    query.box->max.y = pt.y + radius;
+    query.box->max.z = pt.z + radius;
+
+    for(const RecordView& view : db.query(query))
+    {
+      const double dx = view.position.x - pt.x;
+      const double dy = view.position.y - pt.y;
+      const double dz = view.position.z - pt.z;
+      if(dx * dx + dy * dy + dz * dz < radius * radius)
+      {
+        ids.push_back(view.id);
+      }
+    }
+  }
+
+  return ids;
+}
 
-  // Iterate through all points in database to find those that lie within radius of current point
-  for(auto it = db->begin(); it != db->end(); ++it)
+/**
+ * @brief The VisitedSet class is a bitset of record IDs whose bits can be claimed concurrently
+ */
+class VisitedSet
+{
+public:
+
+  explicit VisitedSet(const std::size_t n_ids)
+    : n_ids_(n_ids)
+    , words_((n_ids + 63) / 64)
+  {
+    for(std::atomic<std::uint64_t>& word : words_)
+    {
+      word.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  bool contains(const std::size_t id) const
+  {
+    return id >= n_ids_ || (words_[id / 64].load(std::memory_order_relaxed) & mask(id));
+  }
+
+  /**
+   * @brief claim marks an ID as visited
+   * @return true if the ID was not visited before, i.e. exactly one of the callers claiming the same ID succeeds
+   */
+  bool claim(const std::size_t id)
   {
-    float xp = it->second.goal.position.x;
-    float yp = it->second.goal.position.y;
-    float zp = it->second.goal.position.z;
-    float d2 = std::pow((xp-x), 2.0f) + std::pow((yp-y), 2.0f) + std::pow((zp-z), 2.0f);
+    return id < n_ids_ && !(words_[id / 64].fetch_or(mask(id)) & mask(id));
+  }
+
+private:
+
+  static std::uint64_t mask(const std::size_t id)
+  {
+    return std::uint64_t(1) << (id % 64);
+  }
+
+  const std::size_t n_ids_;
+  std::vector<std::atomic<std::uint64_t>> words_;
+};
+
+/**
+ * @brief The FloodNode struct is a reached record of a flood fill, with its IK solution ordered as the joints of the solver
+ */
+struct FloodNode
+{
+  std::size_t id;
+  geometry_msgs::Point position;
+  std::vector<double> pose;
+};
+
+NeighborReachResult floodFill(ReachDatabasePtr db,
+                              const reach_msgs::ReachRecord& rec,
+                              utils::TaskPool* pool,
+                              const std::vector<reach::plugins::IKSolverBasePtr>& solvers,
+                              const double radius,
+                              const SpatialIndexPtr& spatial_index,
+                              const NeighborGraphPtr& neighbor_graph,
+                              const TransitionCachePtr& cache)
+{
+  NeighborReachResult result;
+  result.reached_pts.push_back(rec.id);
+
+  const std::size_t rec_id = std::stoul(rec.id);
+  VisitedSet visited (std::max(db->getIDLimit(), rec_id + 1));
+  visited.claim(rec_id);
+
+  const std::map<std::string, double> start_solution = jointStateMsgToMap(rec.goal_state);
+  const std::vector<std::string> joint_names = solvers.front()->getJointNames();
+  FloodNode start;
+  start.id = rec_id;
+  start.position = rec.goal.position;
+  start.pose.resize(joint_names.size());
+  for(std::size_t i = 0; i < joint_names.size(); ++i)
+  {
+    start.pose[i] = start_solution.at(joint_names[i]);
+  }
+
+  // Expand the reached region one frontier at a time; the nodes of a frontier are expanded in parallel, and each newly reached record is
+  // claimed in the visited set by exactly one of them
+  const std::size_t n_workers = pool ? pool->size() : 1;
+  std::vector<FloodNode> frontier {std::move(start)};
+  while(!frontier.empty())
+  {
+    std::vector<std::vector<FloodNode>> next (n_workers);
+    std::vector<double> joint_distances (n_workers, 0.0);
+
+    const auto expand = [&](const std::size_t i, const std::size_t worker)
+    {
+      const FloodNode& node = frontier[i];
+
+      // Solve IK for the neighbors that have not been reached yet, using the solution of the node as the seed
+      std::vector<reach_msgs::ReachRecord> neighbors;
+      for(const std::size_t id : getNeighborIDs(node.id, node.position, *db, radius, spatial_index, neighbor_graph))
+      {
+        if(!visited.contains(id))
+        {
+          boost::optional<reach_msgs::ReachRecord> neighbor = db->get(id);
+          if(neighbor)
+          {
+            neighbors.push_back(std::move(*neighbor));
+          }
+        }
+      }
+
+      if(neighbors.empty())
+      {
+        return;
+      }
+
+      std::vector<std::vector<double>> solutions;
+      std::vector<boost::optional<double>> scores;
+      solveTransitions(solvers[worker], node.id, db->getVersion(node.id), node.pose, neighbors, solutions, scores, cache);
+
+      for(std::size_t j = 0; j < neighbors.size(); ++j)
+      {
+        const std::size_t id = std::stoul(neighbors[j].id);
+        if(scores[j] && visited.claim(id))
+        {
+          // Accumulate the joint distance between the seed and new goal states
+          for(std::size_t k = 0; k < node.pose.size(); ++k)
+          {
+            joint_distances[worker] += std::abs(solutions[j][k] - node.pose[k]);
+          }
+
+          FloodNode reached;
+          reached.id = id;
+          reached.position = neighbors[j].goal.position;
+          reached.pose = std::move(solutions[j]);
+          next[worker].push_back(std::move(reached));
+        }
+      }
+    };
+
+    if(pool && frontier.size() > 1)
+    {
+      pool->parallelFor(frontier.size(), expand);
+    }
+    else
+    {
+      for(std::size_t i = 0; i < frontier.size(); ++i)
+      {
+        expand(i, 0);
+      }
+    }
 
-    if(d2 < std::pow(radius, 2.0f) && d2 != 0.0f)
+    frontier.clear();
+    for(std::size_t w = 0; w < n_workers; ++w)
     {
-      reach_records.push_back(it->second);
+      result.joint_distance += joint_distances[w];
+      for(FloodNode& node : next[w])
+      {
+        result.reached_pts.push_back(std::to_string(node.id));
+        frontier.push_back(std::move(node));
+      }
     }
   }
 
-  return reach_records;
+  return result;
 }
 
-std::vector<reach_msgs::ReachRecord> getNeighborsFLANN(const reach_msgs::ReachRecord& rec,
-                                                       const ReachDatabasePtr db,
-                                                       const double radius,
-                                                       SearchTreePtr search_tree)
+} // namespace anonymous
+
+void solveTransitions(reach::plugins::IKSolverBasePtr solver,
+                      const std::size_t source,
+                      const std::uint64_t version,
+                      const std::vector<double>& seed,
+                      const std::vector<reach_msgs::ReachRecord>& targets,
+                      std::vector<std::vector<double>>& solutions,
+                      std::vector<boost::optional<double>>& scores,
+                      TransitionCachePtr cache)
 {
-  flann::Matrix<double> query (new double[3], 1, 3);
-  query[0][0] = (double)rec.goal.position.x;
-  query[0][1] = (double)rec.goal.position.y;
-  query[0][2] = (double)rec.goal.position.z;
+  solutions.assign(targets.size(), std::vector<double>());
+  scores.assign(targets.size(), boost::none);
 
-  std::vector<std::vector<int>> indices;
-  std::vector<std::vector<double>> distances;
-  search_tree->radiusSearch(query, indices, distances, radius, flann::SearchParams());
+  // Look up the cached transitions, and collect the targets that have to be solved
+  std::vector<std::size_t> misses;
+  std::vector<std::size_t> target_ids (targets.size());
+  for(std::size_t i = 0; i < targets.size(); ++i)
+  {
+    target_ids[i] = std::stoul(targets[i].id);
+
+    TransitionCache::Transition transition;
+    if(cache && cache->find(source, version, target_ids[i], seed, targets[i].goal, transition))
+    {
+      scores[i] = transition.score;
+      solutions[i] = std::move(transition.solution);
+    }
+    else
+    {
+      misses.push_back(i);
+    }
+  }
+
+  if(misses.empty())
+  {
+    return;
+  }
+
+  reach::plugins::IsometryVector poses (misses.size());
+  for(std::size_t i = 0; i < misses.size(); ++i)
+  {
+    tf::poseMsgToEigen(targets[misses[i]].goal, poses[i]);
+  }
+
+  std::vector<std::vector<double>> miss_solutions;
+  std::vector<boost::optional<double>> miss_scores;
+  solver->solveIKBatch(poses, std::vector<std::vector<double>>(misses.size(), seed), miss_solutions, miss_scores);
+
+  for(std::size_t i = 0; i < misses.size(); ++i)
+  {
+    const std::size_t j = misses[i];
+    scores[j] = miss_scores[i];
+    solutions[j] = std::move(miss_solutions[i]);
+
+    if(cache)
+    {
+      TransitionCache::Transition transition;
+      transition.score = scores[j];
+      transition.solution = solutions[j];
+      cache->insert(source, version, target_ids[j], seed, targets[j].goal, transition);
+    }
+  }
+}
+
+std::vector<reach_msgs::ReachRecord> getNeighbors(const reach_msgs::ReachRecord& rec,
+                                                  const ReachDatabasePtr db,
+                                                  const double radius,
+                                                  SpatialIndexPtr spatial_index,
+                                                  NeighborGraphPtr neighbor_graph)
+{
+  const std::size_t rec_id = std::stoul(rec.id);
+  const std::vector<std::size_t> ids = getNeighborIDs(rec_id, rec.goal.position, *db, radius, spatial_index, neighbor_graph);
 
   // Create vectors for storing poses and reach record messages that lie within radius of current point
   std::vector<reach_msgs::ReachRecord> neighbors;
-
-  for(std::size_t i = 0; i < indices.size(); ++i)
+  neighbors.reserve(ids.size());
+  for(const std::size_t id : ids)
   {
-    for(std::size_t j = 0; j < indices[i].size(); ++j)
+    if(id == rec_id)
+    {
+      continue;
+    }
+
+    boost::optional<reach_msgs::ReachRecord> neighbor = db->get(id);
+    if(neighbor)
     {
-      auto it = db->begin();
-      std::advance(it, j);
-      neighbors.push_back(it->second);
+      neighbors.push_back(std::move(*neighbor));
     }
   }
 
@@ -83,41 +333,36 @@ NeighborReachResult reachNeighborsDirect(ReachDatabasePtr db,
                                          const reach_msgs::ReachRecord& rec,
                                          reach::plugins::IKSolverBasePtr solver,
                                          const double radius,
-                                         SearchTreePtr search_tree)
+                                         SpatialIndexPtr spatial_index,
+                                         NeighborGraphPtr neighbor_graph,
+                                         TransitionCachePtr cache)
 {
   // Initialize return array of string IDs of msgs that have been updated
   NeighborReachResult result;
 
   // Get all of the neighboring points
-  std::vector<reach_msgs::ReachRecord> neighbors;
-  if(search_tree)
-  {
-    neighbors = getNeighborsFLANN(rec, db, radius, search_tree);
-  }
-  else
-  {
-    neighbors = getNeighbors(rec, db, radius);
-  }
+  const std::vector<reach_msgs::ReachRecord> neighbors = getNeighbors(rec, db, radius, spatial_index, neighbor_graph);
 
   // Solve IK for points that lie within sphere
   if(!neighbors.empty())
   {
-    std::map<std::string, double> previous_solution;
-    for(std::size_t i = 0; i < rec.goal_state.position.size(); ++i)
+    // Use current point's IK solution as the seed of all neighbors, ordered as the joints of the solver
+    const std::map<std::string, double> previous_solution = jointStateMsgToMap(rec.goal_state);
+    const std::vector<std::string> joint_names = solver->getJointNames();
+    std::vector<double> seed (joint_names.size());
+    for(std::size_t i = 0; i < joint_names.size(); ++i)
     {
-      previous_solution.emplace(rec.goal_state.name[i], rec.goal_state.position[i]);
+      seed[i] = previous_solution.at(joint_names[i]);
     }
 
+    const std::size_t rec_id = std::stoul(rec.id);
+    std::vector<std::vector<double>> solutions;
+    std::vector<boost::optional<double>> scores;
+    solveTransitions(solver, rec_id, db->getVersion(rec_id), seed, neighbors, solutions, scores, cache);
+
     for(std::size_t i = 0; i < neighbors.size(); ++i)
     {
-      // Initialize new target pose and new empty robot goal state
-      Eigen::Isometry3d target;
-      tf::poseMsgToEigen(neighbors[i].goal, target);
-
-      // Use current point's IK solution as seed
-      std::vector<double> new_solution;
-      boost::optional<double> score = solver->solveIKFromSeed(target, previous_solution, new_solution);
-
+      const boost::optional<double>& score = scores[i];
       if(score)
       {
         // Change database if currently solved point didn't have solution before
@@ -126,10 +371,12 @@ NeighborReachResult reachNeighborsDirect(ReachDatabasePtr db,
 
         if(!msg.reached || (*score > msg.score))
         {
+          result.updated_pts.emplace_back(msg.id, msg.reached ? *score - msg.score : *score);
+
           // Overwrite Reach Record msg parameters with new results
           msg.reached = true;
           msg.seed_state.position = rec.goal_state.position;
-          msg.goal_state.position = new_solution;
+          msg.goal_state.position = solutions[i];
           msg.score = *score;
           db->put(msg);
         }
@@ -142,70 +389,31 @@ NeighborReachResult reachNeighborsDirect(ReachDatabasePtr db,
   return result;
 }
 
-void reachNeighborsRecursive(ReachDatabasePtr db,
-                             const reach_msgs::ReachRecord& rec,
-                             reach::plugins::IKSolverBasePtr solver,
-                             const double radius,
-                             NeighborReachResult result,
-                             SearchTreePtr search_tree)
+NeighborReachResult reachNeighborsRecursive(ReachDatabasePtr db,
+                                            const reach_msgs::ReachRecord& rec,
+                                            reach::plugins::IKSolverBasePtr solver,
+                                            const double radius,
+                                            SpatialIndexPtr spatial_index,
+                                            NeighborGraphPtr neighbor_graph,
+                                            TransitionCachePtr cache)
 {
-  // Add the current point to the output list of msg IDs
-  result.reached_pts.push_back(rec.id);
-
-  // Create vectors for storing reach record messages that lie within radius of current point
-  std::vector<reach_msgs::ReachRecord> neighbors;
-  if(search_tree)
-  {
-    neighbors = getNeighborsFLANN(rec, db, radius, search_tree);
-  }
-  else
-  {
-    neighbors = getNeighbors(rec, db, radius);
-  }
+  return floodFill(db, rec, nullptr, {solver}, radius, spatial_index, neighbor_graph, cache);
+}
 
-  // Solve IK for points that lie within sphere
-  if(neighbors.size() > 0)
+NeighborReachResult reachNeighborsRecursive(ReachDatabasePtr db,
+                                            const reach_msgs::ReachRecord& rec,
+                                            utils::TaskPool& pool,
+                                            const std::vector<reach::plugins::IKSolverBasePtr>& solvers,
+                                            const double radius,
+                                            SpatialIndexPtr spatial_index,
+                                            NeighborGraphPtr neighbor_graph,
+                                            TransitionCachePtr cache)
+{
+  if(solvers.size() < pool.size())
   {
-    for(std::size_t i = 0; i < neighbors.size(); ++i)
-    {      
-      const std::vector<double>& current_pose = rec.goal_state.position;
-
-      std::map<std::string, double> current_pose_map;
-      for(std::size_t i = 0; i < current_pose.size(); ++i)
-      {
-        current_pose_map.emplace(rec.goal_state.name[i], current_pose[i]);
-      }
-
-      // Check if the current potential point has been solved previously in the recursion chain
-      if(std::find(result.reached_pts.begin(), result.reached_pts.end(), neighbors[i].id) == std::end(result.reached_pts))
-      {
-        std::vector<double> new_pose;
-        Eigen::Isometry3d target;
-        tf::poseMsgToEigen(neighbors[i].goal, target);
-
-        // Use current point's IK solution as seed
-        boost::optional<double> score = solver->solveIKFromSeed(target, current_pose_map, new_pose);
-        if(score)
-        {
-          // Calculate the joint distance between the seed and new goal states
-          for(std::size_t j = 0; j < current_pose.size(); ++j)
-          {
-            result.joint_distance += std::abs(new_pose[j] - current_pose[j]);
-          }
-
-          // Store information in new reach record object
-          reach_msgs::ReachRecord new_rec (neighbors[i]);
-          new_rec.seed_state.position = current_pose;
-          new_rec.goal_state.position = new_pose;
-          new_rec.reached = true;
-          new_rec.score = *score;
-
-          // Recursively enter this function at the new neighboring location
-          reachNeighborsRecursive(db, new_rec, solver, radius, result, search_tree);
-        }
-      }
-    }
+    throw std::invalid_argument("A solver is required for each worker of the pool");
   }
+  return floodFill(db, rec, &pool, solvers, radius, spatial_index, neighbor_graph, cache);
 }
 
 } // namespace core
@@ -0,0 +1,248 @@
+/*
+ * Copyright 2019 Southwest Research Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <reach_core/neighbor_graph.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+
+const static char FILE_MAGIC[8] = {'R', 'E', 'A', 'C', 'H', 'N', 'B', 'R'};
+const static std::uint32_t FILE_VERSION = 1;
+
+/** @brief Relative tolerance within which two neighbor radii are considered equal */
+const static double RADIUS_TOLERANCE = 1.0e-9;
+
+/** @brief Number of records whose neighbors are found per task while building the graph */
+const static std::size_t BATCH_SIZE = 1000;
+
+void hash(std::uint64_t& h, const void* data, const std::size_t size)
+{
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for(std::size_t i = 0; i < size; ++i)
+  {
+    h ^= bytes[i];
+    h *= 1099511628211ULL;
+  }
+}
+
+template<typename T>
+void writeVector(std::ofstream& file, const std::vector<T>& v)
+{
+  const std::uint64_t n = v.size();
+  file.write(reinterpret_cast<const char*>(&n), sizeof(n));
+  file.write(reinterpret_cast<const char*>(v.data()), static_cast<std::streamsize>(n * sizeof(T)));
+}
+
+template<typename T>
+bool readVector(std::ifstream& file, std::vector<T>& v)
+{
+  std::uint64_t n;
+  if(!file.read(reinterpret_cast<char*>(&n), sizeof(n)))
+  {
+    return false;
+  }
+
+  // Check the size against the rest of the file before allocating
+  const std::streampos position = file.tellg();
+  file.seekg(0, std::ios::end);
+  const std::uint64_t remaining = static_cast<std::uint64_t>(file.tellg() - position);
+  file.seekg(position);
+  if(n > remaining / sizeof(T))
+  {
+    return false;
+  }
+
+  v.resize(n);
+  return static_cast<bool>(file.read(reinterpret_cast<char*>(v.data()), static_cast<std::streamsize>(n * sizeof(T))));
+}
+
+} // namespace anonymous
+
+namespace reach
+{
+namespace core
+{
+
+void NeighborGraph::build(utils::TaskPool& pool,
+                          const ReachDatabase& db,
+                          const SpatialIndex& index,
+                          const double radius)
+{
+  std::vector<RecordView> records = db.query(ReachQuery());
+  if(!records.empty() && records.back().id > std::numeric_limits<std::uint32_t>::max())
+  {
+    throw std::runtime_error("Record IDs are too large for the neighbor graph");
+  }
+
+  // Find the neighbors of each batch of records in parallel, ordered by ID, and count them
+  const std::size_t n_batches = (records.size() + BATCH_SIZE - 1) / BATCH_SIZE;
+  std::vector<std::vector<std::pair<std::uint32_t, float>>> neighbors (records.size());
+  pool.parallelFor(n_batches, [&](const std::size_t b, const std::size_t)
+  {
+    for(std::size_t i = b * BATCH_SIZE; i < std::min(records.size(), (b + 1) * BATCH_SIZE); ++i)
+    {
+      const geometry_msgs::Point& pt = records[i].position;
+      for(const std::size_t id : index.radiusSearch(pt, radius))
+      {
+        if(id != records[i].id)
+        {
+          const geometry_msgs::Point other = db.getGoalPosition(id);
+          const double d = std::sqrt(std::pow(other.x - pt.x, 2) + std::pow(other.y - pt.y, 2) + std::pow(other.z - pt.z, 2));
+          neighbors[i].emplace_back(static_cast<std::uint32_t>(id), static_cast<float>(d));
+        }
+      }
+      std::sort(neighbors[i].begin(), neighbors[i].end());
+    }
+  });
+
+  // Lay out the rows by ID, then copy them into place in parallel
+  const std::size_t n_slots = records.empty() ? 0 : records.back().id + 1;
+  offsets_.assign(n_slots + 1, 0);
+  for(std::size_t i = 0; i < records.size(); ++i)
+  {
+    offsets_[records[i].id + 1] = neighbors[i].size();
+  }
+  for(std::size_t id = 0; id < n_slots; ++id)
+  {
+    offsets_[id + 1] += offsets_[id];
+  }
+
+  targets_.resize(offsets_.back());
+  distances_.resize(offsets_.back());
+  pool.parallelFor(n_batches, [&](const std::size_t b, const std::size_t)
+  {
+    for(std::size_t i = b * BATCH_SIZE; i < std::min(records.size(), (b + 1) * BATCH_SIZE); ++i)
+    {
+      std::size_t offset = offsets_[records[i].id];
+      for(const std::pair<std::uint32_t, float>& neighbor : neighbors[i])
+      {
+        targets_[offset] = neighbor.first;
+        distances_[offset] = neighbor.second;
+        ++offset;
+      }
+    }
+  });
+
+  radius_ = radius;
+  fingerprint_ = getFingerprint(db);
+}
+
+bool NeighborGraph::save(const std::string& filename) const
+{
+  std::ofstream file (filename.c_str(), std::ios::out | std::ios::binary);
+  if(!file)
+  {
+    return false;
+  }
+
+  file.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+  file.write(reinterpret_cast<const char*>(&FILE_VERSION), sizeof(FILE_VERSION));
+  file.write(reinterpret_cast<const char*>(&radius_), sizeof(radius_));
+  file.write(reinterpret_cast<const char*>(&fingerprint_), sizeof(fingerprint_));
+  writeVector(file, offsets_);
+  writeVector(file, targets_);
+  writeVector(file, distances_);
+
+  return file.good();
+}
+
+bool NeighborGraph::load(const std::string& filename)
+{
+  std::ifstream file (filename.c_str(), std::ios::in | std::ios::binary);
+  if(!file)
+  {
+    return false;
+  }
+
+  char magic[sizeof(FILE_MAGIC)];
+  std::uint32_t version;
+  file.read(magic, sizeof(magic));
+  file.read(reinterpret_cast<char*>(&version), sizeof(version));
+  if(!file || !std::equal(magic, magic + sizeof(magic), FILE_MAGIC) || version != FILE_VERSION)
+  {
+    return false;
+  }
+
+  double radius;
+  std::uint64_t fingerprint;
+  std::vector<std::uint64_t> offsets;
+  std::vector<std::uint32_t> targets;
+  std::vector<float> distances;
+  file.read(reinterpret_cast<char*>(&radius), sizeof(radius));
+  file.read(reinterpret_cast<char*>(&fingerprint), sizeof(fingerprint));
+  if(!file || !readVector(file, offsets) || !readVector(file, targets) || !readVector(file, distances))
+  {
+    return false;
+  }
+
+  // Check that the rows are consistent with the neighbor arrays, and that every neighbor is a row of the graph
+  if(offsets.empty() || offsets.front() != 0 || offsets.back() != targets.size() || targets.size() != distances.size() ||
+     !std::is_sorted(offsets.begin(), offsets.end()) ||
+     (!targets.empty() && *std::max_element(targets.begin(), targets.end()) >= offsets.size() - 1))
+  {
+    return false;
+  }
+
+  radius_ = radius;
+  fingerprint_ = fingerprint;
+  offsets_ = std::move(offsets);
+  targets_ = std::move(targets);
+  distances_ = std::move(distances);
+  return true;
+}
+
+bool NeighborGraph::matches(const ReachDatabase& db,
+                            const double radius) const
+{
+  return !offsets_.empty() && hasRadius(radius) && getFingerprint(db) == fingerprint_;
+}
+
+bool NeighborGraph::hasRadius(const double radius) const
+{
+  return std::abs(radius - radius_) <= RADIUS_TOLERANCE * std::max(std::abs(radius), std::abs(radius_));
+}
+
+NeighborGraph::Neighbors NeighborGraph::getNeighbors(const std::size_t id) const
+{
+  if(id + 1 >= offsets_.size())
+  {
+    return Neighbors{nullptr, nullptr, 0};
+  }
+
+  const std::size_t offset = offsets_[id];
+  return Neighbors{targets_.data() + offset, distances_.data() + offset, offsets_[id + 1] - offset};
+}
+
+std::uint64_t NeighborGraph::getFingerprint(const ReachDatabase& db)
+{
+  std::uint64_t h = 14695981039346656037ULL;
+  for(const RecordView& record : db.query(ReachQuery()))
+  {
+    const std::uint64_t id = record.id;
+    const double position[3] = {record.position.x, record.position.y, record.position.z};
+    hash(h, &id, sizeof(id));
+    hash(h, position, sizeof(position));
+  }
+  return h;
+}
+
+} // namespace core
+} // namespace reach
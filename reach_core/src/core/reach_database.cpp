@@ -14,27 +14,613 @@
  * limitations under the License.
  */
 #include <reach_core/reach_database.h>
+#include <reach_core/utils/compression_utils.h>
 #include <reach_core/utils/serialization_utils.h>
+#include <reach_core/utils/task_pool.h>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <stdexcept>
 
 namespace
 {
 
-reach_msgs::ReachDatabase toReachDatabase(const std::unordered_map<std::string, reach_msgs::ReachRecord>& map,
-                                          const reach::core::StudyResults& results)
+/** @brief Suffix of the file that lists the IDs of the interpolated records of a saved database */
+const static std::string INTERPOLATED_FILE_SUFFIX = ".interpolated";
+
+/** @brief Identifies database files in the columnar format; files without it are serialized ReachDatabase messages */
+const static char FILE_MAGIC[8] = {'R', 'E', 'A', 'C', 'H', 'D', 'B', '\0'};
+/** @brief Versions 1 and 2 had no neighbor analysis method in the header */
+const static std::uint32_t FILE_VERSION = 3;
+const static std::uint32_t COMPRESSED_FILE_VERSION = 4;
+
+/** @brief Columns of the database file, in the order in which they are stored */
+enum Column
 {
-  reach_msgs::ReachDatabase msg;
-  for (auto it = map.begin(); it != map.end(); ++it)
+  /** @brief uint64 ID of the record at each position */
+  IDS = 0,
+  /** @brief uint8 per slot */
+  REACHED,
+  /** @brief uint8 per slot */
+  INTERPOLATED,
+  /** @brief float64 per slot */
+  SCORES,
+  /** @brief POSE_SIZE float64 per slot */
+  GOALS,
+  /** @brief One float64 per joint per slot */
+  SEED_STATES,
+  GOAL_STATES,
+  N_COLUMNS
+};
+
+/**
+ * @brief The FileHeader struct is stored at the start of a database file in native byte order. It is followed by the joint names (each a
+ * uint32 length and the characters) and the columns, each aligned to 8 bytes. Columns other than IDS have a slot for every ID from 0 to
+ * n_slots - 1, and the slots of IDs without a record are zero
+ */
+struct FileHeader
+{
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t n_joints;
+  std::uint64_t n_records;
+  std::uint64_t n_slots;
+  float total_pose_score;
+  float norm_total_pose_score;
+  float reach_percentage;
+  float avg_num_neighbors;
+  float avg_joint_distance;
+  /** @brief Incremented on every save, to match the file with its log */
+  std::uint32_t generation;
+  /** @brief Index of the method that computed the neighbor metrics in NEIGHBOR_ANALYSIS_METHODS */
+  std::uint32_t neighbor_analysis;
+  std::uint32_t reserved;
+  std::uint64_t column_offsets[N_COLUMNS];
+};
+static_assert(sizeof(FileHeader) % 8 == 0, "Database file header must preserve the alignment of the columns");
+
+/** @brief Methods that compute the neighbor metrics, by their index in the file header; index 0 means that they were not computed */
+const static std::vector<std::string> NEIGHBOR_ANALYSIS_METHODS = {"", "flood_fill", "components"};
+
+std::uint32_t encodeNeighborAnalysis(const std::string& method)
+{
+  const auto it = std::find(NEIGHBOR_ANALYSIS_METHODS.begin(), NEIGHBOR_ANALYSIS_METHODS.end(), method);
+  return it == NEIGHBOR_ANALYSIS_METHODS.end() ? 0 : static_cast<std::uint32_t>(it - NEIGHBOR_ANALYSIS_METHODS.begin());
+}
+
+std::string decodeNeighborAnalysis(const std::uint32_t index)
+{
+  return index < NEIGHBOR_ANALYSIS_METHODS.size() ? NEIGHBOR_ANALYSIS_METHODS[index] : std::string();
+}
+
+/** @brief Databases in the message format predate the component analysis, so their neighbor metrics, if any, come from the flood fill */
+std::string getLegacyNeighborAnalysis(const float avg_num_neighbors)
+{
+  return avg_num_neighbors != 0.0f ? "flood_fill" : "";
+}
+
+/**
+ * @brief The CompressionHeader struct follows the file header in compressed database files. Compressed files are divided into
+ * chunks of chunk_slots consecutive slots (and positions, for the IDS column), and each chunk of each column is compressed separately, so
+ * that the chunks can be encoded and decoded in parallel. column_offsets point to the chunk index of each column: a ChunkEntry per chunk
+ * with the offset and size of its data, which is aligned to 8 bytes
+ *
+ * The goal positions, goal orientation quaternion components and joint positions are rounded to the resolutions stored here, so every
+ * decoded value is within half of its resolution of the value that was saved; the IDs, flags and scores are stored exactly. Before
+ * compression, the rounded values of a chunk are split into one stream per pose component or joint, and the IDs and each stream are stored
+ * as differences between consecutive values, so that slowly varying values become small integers
+ */
+struct CompressionHeader
+{
+  double position_resolution;
+  double orientation_resolution;
+  double joint_resolution;
+  std::uint64_t chunk_slots;
+  std::uint64_t n_chunks;
+};
+static_assert(sizeof(CompressionHeader) % 8 == 0, "Database file header must preserve the alignment of the columns");
+
+struct ChunkEntry
+{
+  std::uint64_t offset;
+  std::uint64_t size;
+};
+
+/** @brief Number of slots per chunk, unless a chunk of the widest column would exceed MAX_CHUNK_BYTES */
+const static std::size_t CHUNK_SLOTS = 16384;
+/** @brief Keeps every chunk well below the 2 GB input limit of LZ4 */
+const static std::size_t MAX_CHUNK_BYTES = 1 << 26;
+
+/** @brief Rounded values must be exactly representable as doubles */
+const static double MAX_QUANTIZED_VALUE = 4503599627370496.0; // 2^52
+
+/** @brief Returns the number of bytes per position (IDS) or slot (all other columns) of a column */
+std::size_t getRowSize(const Column c,
+                       const std::size_t n_joints)
+{
+  switch (c)
   {
-    msg.records.push_back(it->second);
+    case IDS:
+      return sizeof(std::uint64_t);
+    case REACHED:
+    case INTERPOLATED:
+      return 1;
+    case SCORES:
+      return sizeof(double);
+    case GOALS:
+      return 7 * sizeof(double);
+    default:
+      return n_joints * sizeof(double);
   }
+}
 
-  msg.total_pose_score = results.total_pose_score;
-  msg.norm_total_pose_score = results.norm_total_pose_score;
-  msg.reach_percentage = results.reach_percentage;
-  msg.avg_num_neighbors = results.avg_num_neighbors;
-  msg.avg_joint_distance = results.avg_joint_distance;
+void getColumnSizes(const std::size_t n_records,
+                    const std::size_t n_slots,
+                    const std::size_t n_joints,
+                    std::size_t* sizes)
+{
+  for (std::size_t c = 0; c < N_COLUMNS; ++c)
+  {
+    sizes[c] = (c == IDS ? n_records : n_slots) * getRowSize(static_cast<Column>(c), n_joints);
+  }
+}
 
-  return msg;
+std::size_t getChunkSlots(const std::size_t n_joints)
+{
+  const std::size_t row_size = std::max(getRowSize(GOALS, n_joints), getRowSize(SEED_STATES, n_joints));
+  return std::max<std::size_t>(1, std::min(CHUNK_SLOTS, MAX_CHUNK_BYTES / row_size));
+}
+
+/** @brief Returns the first and one past the last row of a chunk of a column with the input number of rows */
+std::pair<std::size_t, std::size_t> getChunkRange(const std::size_t chunk,
+                                                  const std::size_t chunk_slots,
+                                                  const std::size_t n_rows)
+{
+  const std::size_t begin = std::min(chunk * chunk_slots, n_rows);
+  return std::make_pair(begin, std::min(begin + chunk_slots, n_rows));
+}
+
+/**
+ * @brief parallelFor calls the input function for every index in [0, n) on a temporary pool of threads. The database does not share the
+ * pool of the study, since the study may save its database while the pool is busy
+ */
+void parallelFor(const std::size_t n,
+                 const std::function<void(const std::size_t i)>& fn)
+{
+  if (n <= 1)
+  {
+    if (n == 1)
+    {
+      fn(0);
+    }
+    return;
+  }
+
+  const std::size_t n_threads = std::min<std::size_t>(n, std::max(std::thread::hardware_concurrency(), 1u));
+  reach::utils::TaskPool pool (n_threads);
+  pool.parallelFor(n, [&fn](const std::size_t i, const std::size_t) { fn(i); });
+}
+
+/**
+ * @brief encodeIntegers stores each stream of integers (of the input length, one after another) as the differences between consecutive
+ * values, shuffles the bytes of the differences and compresses them
+ */
+std::vector<char> encodeIntegers(const std::vector<std::int64_t>& values,
+                                 const std::size_t stream_length)
+{
+  std::vector<std::uint64_t> deltas (values.size());
+  for (std::size_t i = 0; i < values.size(); ++i)
+  {
+    const std::int64_t previous = i % stream_length == 0 ? 0 : values[i - 1];
+    deltas[i] = reach::utils::zigZagEncode(values[i] - previous);
+  }
+
+  std::vector<char> shuffled (deltas.size() * sizeof(std::uint64_t));
+  reach::utils::shuffleBytes(reinterpret_cast<const char*>(deltas.data()), deltas.size(), sizeof(std::uint64_t), shuffled.data());
+  return reach::utils::compress(shuffled.data(), shuffled.size());
+}
+
+bool decodeIntegers(const char* data,
+                    const std::size_t size,
+                    const std::size_t n,
+                    const std::size_t stream_length,
+                    std::vector<std::int64_t>& values)
+{
+  std::vector<char> shuffled;
+  if (!reach::utils::decompress(data, size, shuffled) || shuffled.size() != n * sizeof(std::uint64_t))
+  {
+    return false;
+  }
+
+  std::vector<std::uint64_t> deltas (n);
+  reach::utils::unshuffleBytes(shuffled.data(), n, sizeof(std::uint64_t), reinterpret_cast<char*>(deltas.data()));
+
+  values.resize(n);
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    const std::int64_t previous = i % stream_length == 0 ? 0 : values[i - 1];
+    values[i] = previous + reach::utils::zigZagDecode(deltas[i]);
+  }
+  return true;
+}
+
+/**
+ * @brief quantize rounds rows of values to the resolution of each value of the row, and stores the result as one stream per value of the
+ * row
+ * @return false if a value cannot be represented at its resolution
+ */
+bool quantize(const char* data,
+              const std::size_t n_rows,
+              const std::vector<double>& resolutions,
+              std::vector<std::int64_t>& out)
+{
+  const std::size_t width = resolutions.size();
+  const double* values = reinterpret_cast<const double*>(data);
+  out.resize(n_rows * width);
+  for (std::size_t i = 0; i < n_rows; ++i)
+  {
+    for (std::size_t j = 0; j < width; ++j)
+    {
+      // Written so that NaN values are also rejected
+      const double q = std::round(values[i * width + j] / resolutions[j]);
+      if (!(std::abs(q) <= MAX_QUANTIZED_VALUE))
+      {
+        return false;
+      }
+      out[j * n_rows + i] = static_cast<std::int64_t>(q);
+    }
+  }
+  return true;
+}
+
+void dequantize(const std::vector<std::int64_t>& in,
+                const std::size_t n_rows,
+                const std::vector<double>& resolutions,
+                char* data)
+{
+  const std::size_t width = resolutions.size();
+  double* values = reinterpret_cast<double*>(data);
+  for (std::size_t i = 0; i < n_rows; ++i)
+  {
+    for (std::size_t j = 0; j < width; ++j)
+    {
+      values[i * width + j] = static_cast<double>(in[j * n_rows + i]) * resolutions[j];
+    }
+  }
+}
+
+/** @brief Resolutions of the values of each row of the quantized columns */
+std::vector<double> getResolutions(const Column c,
+                                   const std::size_t n_joints,
+                                   const CompressionHeader& compression)
+{
+  switch (c)
+  {
+    case GOALS:
+      return {compression.position_resolution, compression.position_resolution, compression.position_resolution,
+              compression.orientation_resolution, compression.orientation_resolution, compression.orientation_resolution,
+              compression.orientation_resolution};
+    case SEED_STATES:
+    case GOAL_STATES:
+      return std::vector<double>(n_joints, compression.joint_resolution);
+    default:
+      return {};
+  }
+}
+
+/**
+ * @brief encodeChunk compresses one chunk of each of the uncompressed columns of a database file
+ * @return false if a value cannot be represented at its resolution
+ */
+bool encodeChunk(const char* const* columns,
+                 const std::size_t n_records,
+                 const std::size_t n_slots,
+                 const std::size_t n_joints,
+                 const CompressionHeader& compression,
+                 const std::size_t chunk,
+                 std::vector<char>* encoded)
+{
+  for (std::size_t i = 0; i < N_COLUMNS; ++i)
+  {
+    const Column c = static_cast<Column>(i);
+    const std::pair<std::size_t, std::size_t> range = getChunkRange(chunk, compression.chunk_slots, c == IDS ? n_records : n_slots);
+    const std::size_t n = range.second - range.first;
+    const char* data = columns[c] + range.first * getRowSize(c, n_joints);
+
+    switch (c)
+    {
+      case IDS:
+      {
+        std::vector<std::int64_t> ids (n);
+        std::memcpy(ids.data(), data, n * sizeof(std::uint64_t));
+        encoded[c] = encodeIntegers(ids, n);
+        break;
+      }
+      case REACHED:
+      case INTERPOLATED:
+        encoded[c] = reach::utils::compress(data, n);
+        break;
+      case SCORES:
+      {
+        std::vector<char> shuffled (n * sizeof(double));
+        reach::utils::shuffleBytes(data, n, sizeof(double), shuffled.data());
+        encoded[c] = reach::utils::compress(shuffled.data(), shuffled.size());
+        break;
+      }
+      default:
+      {
+        std::vector<std::int64_t> quantized;
+        if (!quantize(data, n, getResolutions(c, n_joints, compression), quantized))
+        {
+          return false;
+        }
+        encoded[c] = encodeIntegers(quantized, n);
+        break;
+      }
+    }
+  }
+
+  return true;
+}
+
+/**
+ * @brief decodeChunk decodes one chunk of each of the compressed columns of a mapped database file into the uncompressed columns
+ * @return false if the file is corrupt
+ */
+bool decodeChunk(const char* file,
+                 const ChunkEntry* const* entries,
+                 const std::size_t n_records,
+                 const std::size_t n_slots,
+                 const std::size_t n_joints,
+                 const CompressionHeader& compression,
+                 const std::size_t chunk,
+                 char* const* columns)
+{
+  for (std::size_t i = 0; i < N_COLUMNS; ++i)
+  {
+    const Column c = static_cast<Column>(i);
+    const std::pair<std::size_t, std::size_t> range = getChunkRange(chunk, compression.chunk_slots, c == IDS ? n_records : n_slots);
+    const std::size_t n = range.second - range.first;
+    const std::size_t size = n * getRowSize(c, n_joints);
+    const char* data = file + entries[c][chunk].offset;
+    const std::size_t data_size = entries[c][chunk].size;
+    char* out = columns[c] + range.first * getRowSize(c, n_joints);
+
+    switch (c)
+    {
+      case IDS:
+      {
+        std::vector<std::int64_t> ids;
+        if (!decodeIntegers(data, data_size, n, n, ids))
+        {
+          return false;
+        }
+        std::memcpy(out, ids.data(), size);
+        break;
+      }
+      case REACHED:
+      case INTERPOLATED:
+      case SCORES:
+      {
+        std::vector<char> decompressed;
+        if (!reach::utils::decompress(data, data_size, decompressed) || decompressed.size() != size)
+        {
+          return false;
+        }
+        if (c == SCORES)
+        {
+          reach::utils::unshuffleBytes(decompressed.data(), n, sizeof(double), out);
+        }
+        else
+        {
+          std::copy(decompressed.begin(), decompressed.end(), out);
+        }
+        break;
+      }
+      default:
+      {
+        const std::vector<double> resolutions = getResolutions(c, n_joints, compression);
+        std::vector<std::int64_t> quantized;
+        if (!decodeIntegers(data, data_size, n * resolutions.size(), n, quantized))
+        {
+          return false;
+        }
+        dequantize(quantized, n, resolutions, out);
+        break;
+      }
+    }
+  }
+
+  return true;
+}
+
+std::size_t alignOffset(const std::size_t offset)
+{
+  return (offset + 7) & ~static_cast<std::size_t>(7);
+}
+
+/**
+ * @brief compressFile converts the contents of an uncompressed database file to the compressed format, encoding the chunks in parallel
+ * @return false if a value cannot be represented at its resolution
+ */
+bool compressFile(const std::vector<char>& raw,
+                  const reach::core::StudyCompression& settings,
+                  std::vector<char>& out)
+{
+  FileHeader header;
+  std::memcpy(&header, raw.data(), sizeof(header));
+  const std::size_t n_records = header.n_records;
+  const std::size_t n_slots = header.n_slots;
+  const std::size_t n_joints = header.n_joints;
+
+  CompressionHeader compression;
+  compression.position_resolution = settings.position_resolution;
+  compression.orientation_resolution = settings.orientation_resolution;
+  compression.joint_resolution = settings.joint_resolution;
+  compression.chunk_slots = getChunkSlots(n_joints);
+  compression.n_chunks = (n_slots + compression.chunk_slots - 1) / compression.chunk_slots;
+  const std::size_t n_chunks = compression.n_chunks;
+
+  const char* columns[N_COLUMNS];
+  for (std::size_t c = 0; c < N_COLUMNS; ++c)
+  {
+    columns[c] = raw.data() + header.column_offsets[c];
+  }
+
+  std::vector<std::array<std::vector<char>, N_COLUMNS>> encoded (n_chunks);
+  std::atomic<bool> ok {true};
+  parallelFor(n_chunks, [&](const std::size_t k)
+  {
+    if (!encodeChunk(columns, n_records, n_slots, n_joints, compression, k, encoded[k].data()))
+    {
+      ok = false;
+    }
+  });
+  if (!ok)
+  {
+    return false;
+  }
+
+  // The joint names end where the padding before the first column starts
+  std::size_t names_end = sizeof(FileHeader);
+  for (std::size_t i = 0; i < n_joints; ++i)
+  {
+    std::uint32_t length;
+    std::memcpy(&length, raw.data() + names_end, sizeof(length));
+    names_end += sizeof(length) + length;
+  }
+
+  std::size_t offset = sizeof(FileHeader) + sizeof(CompressionHeader) + (names_end - sizeof(FileHeader));
+  std::vector<std::vector<ChunkEntry>> entries (N_COLUMNS, std::vector<ChunkEntry>(n_chunks));
+  for (std::size_t c = 0; c < N_COLUMNS; ++c)
+  {
+    offset = alignOffset(offset);
+    header.column_offsets[c] = offset;
+    offset += n_chunks * sizeof(ChunkEntry);
+    for (std::size_t k = 0; k < n_chunks; ++k)
+    {
+      offset = alignOffset(offset);
+      entries[c][k].offset = offset;
+      entries[c][k].size = encoded[k][c].size();
+      offset += encoded[k][c].size();
+    }
+  }
+
+  header.version = COMPRESSED_FILE_VERSION;
+  out.assign(offset, 0);
+  std::memcpy(out.data(), &header, sizeof(header));
+  std::memcpy(out.data() + sizeof(header), &compression, sizeof(compression));
+  std::copy(raw.begin() + sizeof(FileHeader), raw.begin() + names_end, out.begin() + sizeof(header) + sizeof(compression));
+  for (std::size_t c = 0; c < N_COLUMNS; ++c)
+  {
+    std::memcpy(out.data() + header.column_offsets[c], entries[c].data(), n_chunks * sizeof(ChunkEntry));
+  }
+
+  parallelFor(n_chunks, [&](const std::size_t k)
+  {
+    for (std::size_t c = 0; c < N_COLUMNS; ++c)
+    {
+      std::copy(encoded[k][c].begin(), encoded[k][c].end(), out.begin() + entries[c][k].offset);
+    }
+  });
+
+  return true;
+}
+
+/** @brief Suffixes of the log of a database file, and of the log that replaces it while the database is being saved */
+const static std::string LOG_FILE_SUFFIX = ".log";
+const static std::string NEXT_LOG_FILE_SUFFIX = ".log.next";
+
+/**
+ * @brief The LogHeader struct is written at the start of a log file, followed by the joint names (as in the database file). Each entry of
+ * the log holds the full state of one record: the uint64 ID, uint8 reached and interpolated flags (padded to 8 bytes), the float64 score,
+ * goal pose, seed state and goal state, and a uint64 checksum of the preceding bytes of the entry
+ */
+struct LogHeader
+{
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t n_joints;
+  std::uint32_t generation;
+  std::uint32_t reserved;
+};
+
+const static char LOG_MAGIC[8] = {'R', 'E', 'A', 'C', 'H', 'L', 'O', 'G'};
+const static std::uint32_t LOG_VERSION = 1;
+
+/** @brief Interval at which the log writer collects the entries buffered by the stripes */
+const static std::chrono::milliseconds LOG_FLUSH_INTERVAL (50);
+
+std::size_t getLogEntrySize(const std::size_t n_joints, const std::size_t pose_size)
+{
+  return 2 * sizeof(std::uint64_t) + (1 + pose_size + 2 * n_joints) * sizeof(double) + sizeof(std::uint64_t);
+}
+
+/** @brief FNV-1a hash, used to detect log entries that were only partially written */
+std::uint64_t checksum(const char* data, const std::size_t size)
+{
+  std::uint64_t hash = 14695981039346656037ULL;
+  for (std::size_t i = 0; i < size; ++i)
+  {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/** @brief Position of the end iterator */
+const static std::size_t END_ID = std::numeric_limits<std::size_t>::max();
+
+/** @brief Marks IDs without a record in the positional index */
+const static std::size_t NO_POSITION = std::numeric_limits<std::size_t>::max();
+
+bool parseID(const std::string& str,
+             std::size_t& id)
+{
+  if(str.empty() || str.find_first_not_of("0123456789") != std::string::npos)
+  {
+    return false;
+  }
+
+  id = static_cast<std::size_t>(std::stoull(str));
+  return true;
+}
+
+/**
+ * @brief copyJointPositions copies the positions of a joint state into the output array in the order of the input joint names
+ */
+void copyJointPositions(const sensor_msgs::JointState& state,
+                        const std::vector<std::string>& joint_names,
+                        double* out)
+{
+  if(state.name.size() != state.position.size())
+  {
+    throw std::invalid_argument("Reach record joint state has " + std::to_string(state.name.size()) + " names but " +
+                                std::to_string(state.position.size()) + " positions");
+  }
+
+  if(state.name == joint_names)
+  {
+    std::copy(state.position.begin(), state.position.end(), out);
+    return;
+  }
+
+  for(std::size_t i = 0; i < joint_names.size(); ++i)
+  {
+    auto it = std::find(state.name.begin(), state.name.end(), joint_names[i]);
+    if(it == state.name.end())
+    {
+      throw std::invalid_argument("Reach record joint state does not contain joint '" + joint_names[i] + "' of the database");
+    }
+    out[i] = state.position[std::distance(state.name.begin(), it)];
+  }
 }
 
 } // namespace anonymous
@@ -71,108 +657,1439 @@ std::map<std::string, double> jointStateMsgToMap(const sensor_msgs::JointState&
   return out;
 }
 
-void ReachDatabase::save(const std::string &filename) const
+ScoreStatistics& ScoreStatistics::operator+=(const ScoreStatistics& other)
 {
-  std::lock_guard<std::mutex> lock {mutex_};
-  reach_msgs::ReachDatabase msg = toReachDatabase(map_, results_);
+  n_records += other.n_records;
+  n_reached += other.n_reached;
+  total_score += other.total_score;
+  for (std::size_t i = 0; i < N_BINS; ++i)
+  {
+    histogram[i] += other.histogram[i];
+  }
+  return *this;
+}
 
-  if (!reach::utils::toFile(filename, msg))
+void ScoreStatistics::update(const bool reached, const double score, const int count)
+{
+  n_records += count;
+  if (reached)
   {
-    throw std::runtime_error("Unable to save database to file: " + filename);
+    n_reached += count;
+    total_score += count * score;
+    histogram[getBin(score)] += count;
   }
 }
 
-bool ReachDatabase::load(const std::string &filename)
+double ScoreStatistics::getPercentile(const double percent) const
 {
-  reach_msgs::ReachDatabase msg;
-  if (!reach::utils::fromFile(filename, msg))
+  if (n_reached == 0)
   {
-    return false;
+    return 0.0;
   }
 
-  std::lock_guard<std::mutex> lock {mutex_};
+  // Rank of the score in the sorted scores, starting at 1
+  const double p = std::min(std::max(percent, 0.0), 100.0) / 100.0;
+  const std::size_t rank = std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(p * n_reached)));
 
-  for (const auto& r : msg.records)
+  std::size_t count = 0;
+  for (std::size_t i = 0; i < N_BINS; ++i)
   {
-    putHelper(r);
-    results_.reach_percentage = msg.reach_percentage;
-    results_.total_pose_score = msg.total_pose_score;
-    results_.norm_total_pose_score = msg.norm_total_pose_score;
-    results_.avg_num_neighbors = msg.avg_num_neighbors;
-    results_.avg_joint_distance = msg.avg_joint_distance;
+    count += histogram[i];
+    if (count >= rank)
+    {
+      return getBinValue(i);
+    }
   }
-  return true;
+  return getBinValue(N_BINS - 1);
 }
 
-boost::optional<reach_msgs::ReachRecord> ReachDatabase::get(const std::string &id) const
+std::size_t ScoreStatistics::getBin(const double score)
 {
-  std::lock_guard<std::mutex> lock {mutex_};
-  auto it = map_.find(id);
-  if (it != map_.end())
+  // Written so that NaN scores also fall into the first bin
+  if (!(score >= std::ldexp(1.0, MIN_EXPONENT)))
   {
-    return {it->second};
+    return 0;
   }
-  else
+  if (score >= std::ldexp(1.0, MAX_EXPONENT))
   {
-    return {};
+    return N_BINS - 1;
+  }
+
+  const double bin = (std::log2(score) - MIN_EXPONENT) * SUB_BINS;
+  return std::min(N_BINS - 2, static_cast<std::size_t>(bin)) + 1;
+}
+
+double ScoreStatistics::getBinValue(const std::size_t bin)
+{
+  if (bin == 0)
+  {
+    return 0.0;
+  }
+  if (bin >= N_BINS - 1)
+  {
+    return std::ldexp(1.0, MAX_EXPONENT);
   }
+  return std::exp2(MIN_EXPONENT + (static_cast<double>(bin) - 0.5) / SUB_BINS);
+}
+
+ReachDatabase::const_iterator::const_iterator(const ReachDatabase* db,
+                                              const std::size_t id)
+  : db_(db)
+  , id_(id)
+{
+
 }
 
-void ReachDatabase::put(const reach_msgs::ReachRecord &record)
+reach_msgs::ReachRecord ReachDatabase::const_iterator::operator*() const
 {
-  std::lock_guard<std::mutex> lock {mutex_};
-  return putHelper(record);
+  std::lock_guard<std::mutex> lock {db_->getStripe(id_)};
+  return db_->getHelper(id_);
 }
 
-void ReachDatabase::putHelper(const reach_msgs::ReachRecord &record)
+ReachDatabase::const_iterator& ReachDatabase::const_iterator::operator++()
 {
-  map_[record.id] = record;
+  id_ = db_->nextHelper(id_ + 1);
+  return *this;
 }
 
-std::size_t ReachDatabase::size() const
+std::vector<std::unique_lock<std::mutex>> ReachDatabase::lockAll() const
 {
-  return map_.size();
+  // Stripes are always locked in the same order so that concurrent callers cannot deadlock
+  std::vector<std::unique_lock<std::mutex>> locks;
+  locks.reserve(N_STRIPES);
+  for (Stripe& stripe : stripes_)
+  {
+    locks.emplace_back(stripe.mutex);
+  }
+  return locks;
 }
 
-void ReachDatabase::calculateResults()
+void ReachDatabase::save(const std::string &filename) const
 {
-  unsigned int success = 0, total = 0;
-  double score = 0.0;
-  for(int i = 0; i < this->size(); ++i)
+  // Only hold the lock while copying the columns, so that concurrent writers are not blocked while the file is compressed and written
+  std::vector<char> buffer;
+  StudyCompression compression;
+  bool compact;
+  std::size_t rotation;
   {
-    reach_msgs::ReachRecord msg = *this->get(std::to_string(i));
+    const auto locks = lockAll();
+
+    // Every snapshot gets a new generation, so that the log of an earlier snapshot is never replayed on top of it
+    ++generation_;
+    buffer = serializeHelper();
+    compression = compression_;
+
+    // Saving the logged database compacts the log: changes from here on go to a new log file for the new snapshot. The old log stays
+    // in place until the snapshot is written, so an interruption in between can still be recovered from the old snapshot and both logs
+    compact = logging_ && filename == log_filename_;
+    if (compact)
+    {
+      std::lock_guard<std::mutex> lock {log_mutex_};
+      queueLogEntriesHelper();
+      log_queue_.push_back(LogItem{{}, true, generation_});
+      rotation = ++log_rotations_requested_;
+      log_cv_.notify_all();
+    }
+  }
 
-    if(msg.reached)
+  if (compression.enable)
+  {
+    std::vector<char> compressed;
+    if (compressFile(buffer, compression, compressed))
+    {
+      buffer.swap(compressed);
+    }
+    else
     {
-      success++;
-      score += msg.score;
+      ROS_WARN("Reach database values are too large for the compression resolution; saving the database uncompressed");
     }
+  }
 
-    total ++;
+  // Write to a temporary file and move it into place, so that an interruption never leaves a partially written database behind
+  const std::string tmp_filename = filename + ".tmp";
+  {
+    std::ofstream file (tmp_filename.c_str(), std::ios::out | std::ios::binary);
+    if (!file || !file.write(buffer.data(), static_cast<std::streamsize>(buffer.size())))
+    {
+      throw std::runtime_error("Unable to save database to file: " + filename);
+    }
+  }
+  if (std::rename(tmp_filename.c_str(), filename.c_str()) != 0)
+  {
+    throw std::runtime_error("Unable to save database to file: " + filename);
   }
-  const float pct_success = static_cast<float>(success) / static_cast<float>(total);
 
-  results_.reach_percentage = 100.0f * pct_success;
-  results_.total_pose_score = score;
-  results_.norm_total_pose_score = score / pct_success;
+  // The interpolated flags are part of the columnar format, so the file that held them for the legacy format is no longer needed
+  std::remove((filename + INTERPOLATED_FILE_SUFFIX).c_str());
+
+  if (compact)
+  {
+    std::unique_lock<std::mutex> lock {log_mutex_};
+    log_cv_.wait(lock, [&] { return log_rotations_done_ >= rotation; });
+    std::rename((filename + NEXT_LOG_FILE_SUFFIX).c_str(), (filename + LOG_FILE_SUFFIX).c_str());
+  }
 }
 
-void ReachDatabase::printResults()
+ReachDatabase::~ReachDatabase()
 {
-  ROS_INFO("------------------------------------------------");
-  ROS_INFO_STREAM("Percent Reached = " << results_.reach_percentage);
-  ROS_INFO_STREAM("Total points score = " << results_.total_pose_score);
-  ROS_INFO_STREAM("Normalized total points score = " << results_.norm_total_pose_score);
-  ROS_INFO_STREAM("Average reachable neighbors = " << results_.avg_num_neighbors);
-  ROS_INFO_STREAM("Average joint distance = " << results_.avg_joint_distance);
-  ROS_INFO_STREAM("------------------------------------------------");
+  stopLog();
 }
 
-reach_msgs::ReachDatabase ReachDatabase::toReachDatabaseMsg()
+void ReachDatabase::startLog(const std::string &filename)
 {
-  return toReachDatabase(map_, results_);
+  stopLog();
+
+  {
+    const auto locks = lockAll();
+    log_filename_ = filename;
+    log_queue_.clear();
+    for (Stripe& stripe : stripes_)
+    {
+      stripe.log_entries.clear();
+    }
+    log_stop_ = false;
+    log_rotations_requested_ = 0;
+    log_rotations_done_ = 0;
+    logging_ = true;
+  }
+  log_thread_ = std::thread(&ReachDatabase::writeLog, this);
+
+  // The first snapshot starts the log file
+  save(filename);
 }
 
-} // namespace core
-} // namespace reach
+void ReachDatabase::stopLog()
+{
+  if (!log_thread_.joinable())
+  {
+    return;
+  }
+
+  {
+    const auto locks = lockAll();
+    logging_ = false;
+
+    std::lock_guard<std::mutex> lock {log_mutex_};
+    queueLogEntriesHelper();
+    log_stop_ = true;
+  }
+  log_cv_.notify_all();
+  log_thread_.join();
+}
 
+void ReachDatabase::writeLog() const
+{
+  std::ofstream file;
+  bool has_header = false;
+  std::uint32_t generation = 0;
+
+  std::unique_lock<std::mutex> lock {log_mutex_};
+  while (true)
+  {
+    // Saving and stopping queue the buffered entries themselves; otherwise they are collected periodically, in one batch for every stripe.
+    // The stripes are locked before the queue, in the same order as when saving, so that no entry can end up on the wrong side of a
+    // rotation of the log
+    if (!log_cv_.wait_for(lock, LOG_FLUSH_INTERVAL, [this] { return !log_queue_.empty() || log_stop_; }))
+    {
+      lock.unlock();
+      {
+        const auto locks = lockAll();
+        std::lock_guard<std::mutex> queue_lock {log_mutex_};
+        queueLogEntriesHelper();
+      }
+      lock.lock();
+    }
+
+    if (log_queue_.empty())
+    {
+      if (log_stop_)
+      {
+        return;
+      }
+      continue;
+    }
+
+    // Write the pending items without holding the lock, so that writers of the database are not blocked by the file system
+    std::deque<LogItem> items;
+    items.swap(log_queue_);
+    lock.unlock();
+
+    std::size_t rotations = 0;
+    for (const LogItem& item : items)
+    {
+      if (item.rotate)
+      {
+        file.close();
+        file.clear();
+        file.open((log_filename_ + NEXT_LOG_FILE_SUFFIX).c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        generation = item.generation;
+        has_header = false;
+        ++rotations;
+      }
+      // Changes made before the first snapshot are part of it
+      else if (file.is_open())
+      {
+        // The joints of the database are set before the first record is logged, and never change afterwards
+        if (!has_header)
+        {
+          LogHeader header;
+          std::copy(LOG_MAGIC, LOG_MAGIC + sizeof(LOG_MAGIC), header.magic);
+          header.version = LOG_VERSION;
+          header.n_joints = static_cast<std::uint32_t>(joint_names_.size());
+          header.generation = generation;
+          header.reserved = 0;
+          file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+          for (const std::string& name : joint_names_)
+          {
+            const std::uint32_t length = static_cast<std::uint32_t>(name.size());
+            file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+            file.write(name.data(), name.size());
+          }
+          has_header = true;
+        }
+        file.write(item.entries.data(), static_cast<std::streamsize>(item.entries.size()));
+      }
+    }
+
+    file.flush();
+    if (file.is_open() && !file)
+    {
+      ROS_ERROR_STREAM("Unable to write reach database log for '" << log_filename_ << "'");
+    }
+
+    lock.lock();
+    log_rotations_done_ += rotations;
+    log_cv_.notify_all();
+  }
+}
+
+void ReachDatabase::encodeLogEntryHelper(const std::size_t id, std::vector<char>& buffer) const
+{
+  const std::size_t n_joints = joint_names_.size();
+  const std::size_t start = buffer.size();
+  buffer.resize(start + getLogEntrySize(n_joints, POSE_SIZE), 0);
+
+  char* const entry = buffer.data() + start;
+  char* data = entry;
+  const std::uint64_t id64 = id;
+  std::memcpy(data, &id64, sizeof(id64));
+  data[sizeof(id64)] = reached_[id];
+  data[sizeof(id64) + 1] = interpolated_[id];
+  data += 2 * sizeof(std::uint64_t);
+
+  std::memcpy(data, &scores_[id], sizeof(double));
+  data += sizeof(double);
+  std::memcpy(data, &goals_[id * POSE_SIZE], POSE_SIZE * sizeof(double));
+  data += POSE_SIZE * sizeof(double);
+  std::memcpy(data, getSeedStateHelper(id), n_joints * sizeof(double));
+  data += n_joints * sizeof(double);
+  std::memcpy(data, getGoalStateHelper(id), n_joints * sizeof(double));
+  data += n_joints * sizeof(double);
+
+  const std::uint64_t sum = checksum(entry, data - entry);
+  std::memcpy(data, &sum, sizeof(sum));
+}
+
+void ReachDatabase::queueLogEntriesHelper() const
+{
+  for (Stripe& stripe : stripes_)
+  {
+    if (!stripe.log_entries.empty())
+    {
+      log_queue_.push_back(LogItem{std::move(stripe.log_entries), false, 0});
+      stripe.log_entries.clear();
+    }
+  }
+  log_cv_.notify_all();
+}
+
+std::size_t ReachDatabase::replayLog(const std::string &filename)
+{
+  // Only logs of the snapshot in the file are replayed
+  std::ifstream file (filename.c_str(), std::ios::in | std::ios::binary);
+  FileHeader header;
+  if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      !std::equal(FILE_MAGIC, FILE_MAGIC + sizeof(FILE_MAGIC), header.magic))
+  {
+    return 0;
+  }
+
+  // The log of the snapshot holds the changes made after it was saved. If the database was interrupted while it was being saved again,
+  // the log of the next snapshot holds the changes made after that save began, and applies on top of the first log
+  std::size_t n = 0;
+  for (const std::uint32_t generation : {header.generation, header.generation + 1})
+  {
+    n += replayLogFile(filename + LOG_FILE_SUFFIX, generation);
+    n += replayLogFile(filename + NEXT_LOG_FILE_SUFFIX, generation);
+  }
+  return n;
+}
+
+std::size_t ReachDatabase::replayLogFile(const std::string &filename, const std::uint32_t generation)
+{
+  std::ifstream file (filename.c_str(), std::ios::in | std::ios::binary);
+  LogHeader header;
+  if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      !std::equal(LOG_MAGIC, LOG_MAGIC + sizeof(LOG_MAGIC), header.magic) || header.version != LOG_VERSION ||
+      header.generation != generation)
+  {
+    return 0;
+  }
+
+  std::vector<std::string> joint_names (header.n_joints);
+  for (std::string& name : joint_names)
+  {
+    std::uint32_t length;
+    if (!file.read(reinterpret_cast<char*>(&length), sizeof(length)))
+    {
+      return 0;
+    }
+    name.resize(length);
+    if (!file.read(&name[0], length))
+    {
+      return 0;
+    }
+  }
+
+  const std::size_t n_joints = joint_names.size();
+  std::vector<char> entry (getLogEntrySize(n_joints, POSE_SIZE));
+
+  const auto locks = lockAll();
+
+  // The log ends at the first entry that was not completely written
+  std::size_t n = 0;
+  while (file.read(entry.data(), static_cast<std::streamsize>(entry.size())))
+  {
+    const std::size_t checksum_offset = entry.size() - sizeof(std::uint64_t);
+    std::uint64_t sum;
+    std::memcpy(&sum, entry.data() + checksum_offset, sizeof(sum));
+    if (sum != checksum(entry.data(), checksum_offset))
+    {
+      break;
+    }
+
+    const char* data = entry.data();
+    std::uint64_t id;
+    std::memcpy(&id, data, sizeof(id));
+    const bool interpolated = data[sizeof(id) + 1];
+
+    reach_msgs::ReachRecord r;
+    r.id = std::to_string(id);
+    r.reached = data[sizeof(id)];
+    data += 2 * sizeof(std::uint64_t);
+
+    double values[POSE_SIZE + 1];
+    std::memcpy(values, data, sizeof(values));
+    data += sizeof(values);
+    r.score = values[0];
+    r.goal.position.x = values[1];
+    r.goal.position.y = values[2];
+    r.goal.position.z = values[3];
+    r.goal.orientation.x = values[4];
+    r.goal.orientation.y = values[5];
+    r.goal.orientation.z = values[6];
+    r.goal.orientation.w = values[7];
+
+    r.seed_state.name = joint_names;
+    r.seed_state.position.resize(n_joints);
+    std::memcpy(r.seed_state.position.data(), data, n_joints * sizeof(double));
+    data += n_joints * sizeof(double);
+    r.goal_state.name = joint_names;
+    r.goal_state.position.resize(n_joints);
+    std::memcpy(r.goal_state.position.data(), data, n_joints * sizeof(double));
+
+    prepareHelper(id, r);
+    putHelper(id, r, interpolated);
+    ++n;
+  }
+
+  return n;
+}
+
+std::vector<char> ReachDatabase::serializeHelper() const
+{
+  const std::size_t n_records = ids_.size();
+  const std::size_t n_joints = joint_names_.size();
+  const std::size_t n_slots = ids_.empty() ? 0 : *std::max_element(ids_.begin(), ids_.end()) + 1;
+
+  ScoreStatistics statistics;
+  for (const Stripe& stripe : stripes_)
+  {
+    statistics += stripe.statistics;
+  }
+  const StudyResults results = getStudyResultsHelper(statistics);
+
+  FileHeader header;
+  std::copy(FILE_MAGIC, FILE_MAGIC + sizeof(FILE_MAGIC), header.magic);
+  header.version = FILE_VERSION;
+  header.n_joints = static_cast<std::uint32_t>(n_joints);
+  header.n_records = n_records;
+  header.n_slots = n_slots;
+  header.total_pose_score = results.total_pose_score;
+  header.norm_total_pose_score = results.norm_total_pose_score;
+  header.reach_percentage = results.reach_percentage;
+  header.avg_num_neighbors = results.avg_num_neighbors;
+  header.avg_joint_distance = results.avg_joint_distance;
+  header.generation = generation_;
+  header.neighbor_analysis = encodeNeighborAnalysis(results.neighbor_analysis);
+  header.reserved = 0;
+
+  std::size_t offset = sizeof(FileHeader);
+  for (const std::string& name : joint_names_)
+  {
+    offset += sizeof(std::uint32_t) + name.size();
+  }
+
+  std::size_t column_sizes[N_COLUMNS];
+  getColumnSizes(n_records, n_slots, n_joints, column_sizes);
+  for (std::size_t c = 0; c < N_COLUMNS; ++c)
+  {
+    offset = alignOffset(offset);
+    header.column_offsets[c] = offset;
+    offset += column_sizes[c];
+  }
+
+  std::vector<char> buffer (offset, 0);
+  std::memcpy(buffer.data(), &header, sizeof(header));
+
+  char* names = buffer.data() + sizeof(header);
+  for (const std::string& name : joint_names_)
+  {
+    const std::uint32_t length = static_cast<std::uint32_t>(name.size());
+    std::memcpy(names, &length, sizeof(length));
+    std::memcpy(names + sizeof(length), name.data(), name.size());
+    names += sizeof(length) + name.size();
+  }
+
+  char* columns[N_COLUMNS];
+  for (std::size_t c = 0; c < N_COLUMNS; ++c)
+  {
+    columns[c] = buffer.data() + header.column_offsets[c];
+  }
+
+  // Copy the columns in chunks of slots in parallel; the slots of IDs without a record stay zero
+  const std::size_t chunk_slots = getChunkSlots(n_joints);
+  const std::size_t state_size = n_joints * sizeof(double);
+  parallelFor((n_slots + chunk_slots - 1) / chunk_slots, [&](const std::size_t k)
+  {
+    const std::pair<std::size_t, std::size_t> positions = getChunkRange(k, chunk_slots, n_records);
+    for (std::size_t p = positions.first; p < positions.second; ++p)
+    {
+      const std::uint64_t id = ids_[p];
+      std::memcpy(columns[IDS] + p * sizeof(id), &id, sizeof(id));
+    }
+
+    const std::pair<std::size_t, std::size_t> slots = getChunkRange(k, chunk_slots, n_slots);
+    const std::size_t n = slots.second - slots.first;
+    std::copy_n(reached_.begin() + slots.first, n, columns[REACHED] + slots.first);
+    std::copy_n(interpolated_.begin() + slots.first, n, columns[INTERPOLATED] + slots.first);
+    std::memcpy(columns[SCORES] + slots.first * sizeof(double), scores_.data() + slots.first, n * sizeof(double));
+    std::memcpy(columns[GOALS] + slots.first * POSE_SIZE * sizeof(double), goals_.data() + slots.first * POSE_SIZE,
+                n * POSE_SIZE * sizeof(double));
+    for (std::size_t id = slots.first; id < slots.second; ++id)
+    {
+      if (hasHelper(id))
+      {
+        std::memcpy(columns[SEED_STATES] + id * state_size, getSeedStateHelper(id), state_size);
+        std::memcpy(columns[GOAL_STATES] + id * state_size, getGoalStateHelper(id), state_size);
+      }
+    }
+  });
+
+  return buffer;
+}
+
+void ReachDatabase::setCompression(const StudyCompression &compression)
+{
+  const auto locks = lockAll();
+  compression_ = compression;
+}
+
+bool ReachDatabase::load(const std::string &filename)
+{
+  const utils::MappedFilePtr file = utils::MappedFile::open(filename);
+  if (!file)
+  {
+    return false;
+  }
+
+  if (file->size() >= sizeof(FILE_MAGIC) && std::equal(FILE_MAGIC, FILE_MAGIC + sizeof(FILE_MAGIC), file->data()))
+  {
+    return loadColumns(file);
+  }
+  return loadLegacy(filename);
+}
+
+bool ReachDatabase::loadColumns(const utils::MappedFilePtr& file)
+{
+  if (file->size() < sizeof(FileHeader))
+  {
+    return false;
+  }
+
+  FileHeader header;
+  std::memcpy(&header, file->data(), sizeof(header));
+  if (header.version != FILE_VERSION && header.version != COMPRESSED_FILE_VERSION)
+  {
+    ROS_ERROR_STREAM("Unsupported reach database file version " << header.version);
+    return false;
+  }
+
+  const bool compressed = header.version == COMPRESSED_FILE_VERSION;
+  CompressionHeader compression;
+  std::size_t offset = sizeof(FileHeader);
+  if (compressed)
+  {
+    if (file->size() < offset + sizeof(compression))
+    {
+      return false;
+    }
+    std::memcpy(&compression, file->data() + offset, sizeof(compression));
+    offset += sizeof(compression);
+  }
+
+  // Validate the layout of the file before reading any of it
+  std::vector<std::string> joint_names;
+  for (std::uint32_t i = 0; i < header.n_joints; ++i)
+  {
+    std::uint32_t length;
+    if (offset + sizeof(length) > file->size())
+    {
+      return false;
+    }
+    std::memcpy(&length, file->data() + offset, sizeof(length));
+    offset += sizeof(length);
+    if (offset + length > file->size())
+    {
+      return false;
+    }
+    joint_names.emplace_back(file->data() + offset, length);
+    offset += length;
+  }
+
+  const std::size_t n_records = header.n_records;
+  const std::size_t n_slots = header.n_slots;
+  const std::size_t n_joints = header.n_joints;
+  std::size_t column_sizes[N_COLUMNS];
+  getColumnSizes(n_records, n_slots, n_joints, column_sizes);
+  const std::size_t n_chunks = compressed ? compression.n_chunks : 0;
+  if (compressed && (compression.chunk_slots == 0 ||
+                     n_chunks != (n_slots + compression.chunk_slots - 1) / compression.chunk_slots))
+  {
+    return false;
+  }
+
+  const ChunkEntry* entries[N_COLUMNS];
+  for (std::size_t c = 0; c < N_COLUMNS; ++c)
+  {
+    const std::uint64_t column_offset = header.column_offsets[c];
+    const std::uint64_t stored_size = compressed ? n_chunks * sizeof(ChunkEntry) : column_sizes[c];
+    if (column_offset % 8 != 0 || column_offset < offset || column_offset > file->size() ||
+        stored_size > file->size() - column_offset)
+    {
+      return false;
+    }
+
+    entries[c] = reinterpret_cast<const ChunkEntry*>(file->data() + column_offset);
+    for (std::size_t k = 0; k < n_chunks; ++k)
+    {
+      if (entries[c][k].offset > file->size() || entries[c][k].size > file->size() - entries[c][k].offset)
+      {
+        return false;
+      }
+    }
+  }
+
+  // Uncompressed columns are read from the mapped file; compressed columns are decoded into memory, one chunk per task
+  const char* columns[N_COLUMNS];
+  std::vector<char> decoded[N_COLUMNS];
+  if (compressed)
+  {
+    char* outputs[N_COLUMNS];
+    for (std::size_t c = 0; c < N_COLUMNS; ++c)
+    {
+      decoded[c].resize(column_sizes[c]);
+      outputs[c] = decoded[c].data();
+      columns[c] = decoded[c].data();
+    }
+
+    std::atomic<bool> ok {true};
+    parallelFor(n_chunks, [&](const std::size_t k)
+    {
+      if (!decodeChunk(file->data(), entries, n_records, n_slots, n_joints, compression, k, outputs))
+      {
+        ok = false;
+      }
+    });
+    if (!ok)
+    {
+      return false;
+    }
+  }
+  else
+  {
+    for (std::size_t c = 0; c < N_COLUMNS; ++c)
+    {
+      columns[c] = file->data() + header.column_offsets[c];
+    }
+  }
+
+  const std::uint64_t* ids = reinterpret_cast<const std::uint64_t*>(columns[IDS]);
+  std::vector<char> seen (n_slots, 0);
+  for (std::size_t p = 0; p < n_records; ++p)
+  {
+    if (ids[p] >= n_slots || seen[ids[p]])
+    {
+      return false;
+    }
+    seen[ids[p]] = 1;
+  }
+
+  const char* reached = columns[REACHED];
+  const char* interpolated = columns[INTERPOLATED];
+  const double* scores = reinterpret_cast<const double*>(columns[SCORES]);
+  const double* goals = reinterpret_cast<const double*>(columns[GOALS]);
+  const double* seed_states = reinterpret_cast<const double*>(columns[SEED_STATES]);
+  const double* goal_states = reinterpret_cast<const double*>(columns[GOAL_STATES]);
+
+  const auto locks = lockAll();
+
+  // Later snapshots must not reuse the generation of the loaded file
+  generation_ = std::max(generation_, header.generation);
+
+  if (ids_.empty() && n_records > 0)
+  {
+    // Copy the columns into an empty database directly, and leave the joint states of an uncompressed file in the file until they are
+    // modified
+    joint_names_ = joint_names;
+    has_joints_ = true;
+    if (compressed)
+    {
+      seed_states_.assign(seed_states, seed_states + n_slots * n_joints);
+      goal_states_.assign(goal_states, goal_states + n_slots * n_joints);
+    }
+    else
+    {
+      seed_states_.clear();
+      goal_states_.clear();
+      mapped_file_ = file;
+      mapped_seed_states_ = seed_states;
+      mapped_goal_states_ = goal_states;
+      n_mapped_slots_ = n_slots;
+      has_mapped_states_ = true;
+    }
+
+    growHelper(std::max(n_slots, positions_.size()));
+    std::copy(reached, reached + n_slots, reached_.begin());
+    std::copy(interpolated, interpolated + n_slots, interpolated_.begin());
+    std::copy(scores, scores + n_slots, scores_.begin());
+    std::copy(goals, goals + n_slots * POSE_SIZE, goals_.begin());
+
+    ids_.assign(ids, ids + n_records);
+    for (std::size_t p = 0; p < n_records; ++p)
+    {
+      const std::size_t id = ids_[p];
+      positions_[id] = p;
+      stripes_[id % N_STRIPES].statistics.update(reached_[id], scores_[id], 1);
+    }
+    std::fill(versions_.begin(), versions_.end(), ++version_);
+  }
+  else
+  {
+    // Merge the records into the existing records of the database
+    for (std::size_t p = 0; p < n_records; ++p)
+    {
+      const std::size_t id = ids[p];
+
+      reach_msgs::ReachRecord r;
+      r.id = std::to_string(id);
+      r.reached = reached[id];
+      r.score = scores[id];
+      const double* goal = goals + id * POSE_SIZE;
+      r.goal.position.x = goal[0];
+      r.goal.position.y = goal[1];
+      r.goal.position.z = goal[2];
+      r.goal.orientation.x = goal[3];
+      r.goal.orientation.y = goal[4];
+      r.goal.orientation.z = goal[5];
+      r.goal.orientation.w = goal[6];
+      r.seed_state.name = joint_names;
+      r.seed_state.position.assign(seed_states + id * n_joints, seed_states + (id + 1) * n_joints);
+      r.goal_state.name = joint_names;
+      r.goal_state.position.assign(goal_states + id * n_joints, goal_states + (id + 1) * n_joints);
+
+      prepareHelper(id, r);
+      putHelper(id, r, interpolated[id]);
+    }
+  }
+
+  if (n_records > 0)
+  {
+    results_.avg_num_neighbors = header.avg_num_neighbors;
+    results_.avg_joint_distance = header.avg_joint_distance;
+    results_.neighbor_analysis = decodeNeighborAnalysis(header.neighbor_analysis);
+  }
+
+  return true;
+}
+
+bool ReachDatabase::loadLegacy(const std::string &filename)
+{
+  reach_msgs::ReachDatabase msg;
+  if (!reach::utils::fromFile(filename, msg))
+  {
+    return false;
+  }
+
+  // Databases saved without any interpolated records have no interpolated record file
+  std::vector<std::string> interpolated;
+  const std::string interpolated_filename = filename + INTERPOLATED_FILE_SUFFIX;
+  if (boost::filesystem::exists(interpolated_filename) && !reach::utils::fromFile(interpolated_filename, interpolated))
+  {
+    return false;
+  }
+
+  const auto locks = lockAll();
+
+  for (const auto& r : msg.records)
+  {
+    std::size_t id;
+    if (!parseID(r.id, id))
+    {
+      throw std::invalid_argument("Reach record ID must be a non-negative integer: '" + r.id + "'");
+    }
+    prepareHelper(id, r);
+    putHelper(id, r, false);
+  }
+
+  // The reach percentage and scores are recalculated from the records as they are added
+  if (!msg.records.empty())
+  {
+    results_.avg_num_neighbors = msg.avg_num_neighbors;
+    results_.avg_joint_distance = msg.avg_joint_distance;
+    results_.neighbor_analysis = getLegacyNeighborAnalysis(msg.avg_num_neighbors);
+  }
+
+  for (const std::string& str : interpolated)
+  {
+    std::size_t id;
+    if (parseID(str, id) && hasHelper(id))
+    {
+      interpolated_[id] = 1;
+    }
+  }
+
+  return true;
+}
+
+bool ReachDatabase::loadResults(const std::string &filename,
+                                StudyResults &results)
+{
+  std::ifstream file (filename.c_str(), std::ios::in | std::ios::binary);
+  if (!file)
+  {
+    return false;
+  }
+
+  FileHeader header;
+  file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (file && std::equal(FILE_MAGIC, FILE_MAGIC + sizeof(FILE_MAGIC), header.magic))
+  {
+    if (header.version != FILE_VERSION && header.version != COMPRESSED_FILE_VERSION)
+    {
+      return false;
+    }
+    results.reach_percentage = header.reach_percentage;
+    results.total_pose_score = header.total_pose_score;
+    results.norm_total_pose_score = header.norm_total_pose_score;
+    results.avg_num_neighbors = header.avg_num_neighbors;
+    results.avg_joint_distance = header.avg_joint_distance;
+    results.neighbor_analysis = decodeNeighborAnalysis(header.neighbor_analysis);
+    return true;
+  }
+
+  // The summary fields are the last fields of the ReachDatabase message, so they are serialized at the end of legacy files
+  float summary[5];
+  file.clear();
+  file.seekg(-static_cast<std::streamoff>(sizeof(summary)), std::ios::end);
+  file.read(reinterpret_cast<char*>(summary), sizeof(summary));
+  if (!file)
+  {
+    return false;
+  }
+  results.reach_percentage = summary[0];
+  results.total_pose_score = summary[1];
+  results.norm_total_pose_score = summary[2];
+  results.avg_num_neighbors = summary[3];
+  results.avg_joint_distance = summary[4];
+  results.neighbor_analysis = getLegacyNeighborAnalysis(summary[3]);
+  return true;
+}
+
+void ReachDatabase::remove(const std::string &filename)
+{
+  std::remove(filename.c_str());
+  std::remove((filename + INTERPOLATED_FILE_SUFFIX).c_str());
+  std::remove((filename + LOG_FILE_SUFFIX).c_str());
+  std::remove((filename + NEXT_LOG_FILE_SUFFIX).c_str());
+}
+
+void ReachDatabase::rename(const std::string &filename,
+                           const std::string &new_filename)
+{
+  if (!boost::filesystem::exists(filename))
+  {
+    return;
+  }
+
+  // Clear the destination first, so that none of its associated files are left next to the moved database
+  remove(new_filename);
+  for (const std::string& suffix : {std::string(), INTERPOLATED_FILE_SUFFIX, LOG_FILE_SUFFIX, NEXT_LOG_FILE_SUFFIX})
+  {
+    std::rename((filename + suffix).c_str(), (new_filename + suffix).c_str());
+  }
+}
+
+boost::optional<reach_msgs::ReachRecord> ReachDatabase::get(const std::string &id) const
+{
+  std::size_t i;
+  if (!parseID(id, i))
+  {
+    return {};
+  }
+  return get(i);
+}
+
+boost::optional<reach_msgs::ReachRecord> ReachDatabase::get(const std::size_t id) const
+{
+  std::lock_guard<std::mutex> lock {getStripe(id)};
+  if (hasHelper(id))
+  {
+    return {getHelper(id)};
+  }
+  else
+  {
+    return {};
+  }
+}
+
+void ReachDatabase::put(const reach_msgs::ReachRecord &record, const bool interpolated)
+{
+  std::size_t id;
+  if (!parseID(record.id, id))
+  {
+    throw std::invalid_argument("Reach record ID must be a non-negative integer: '" + record.id + "'");
+  }
+
+  // The arrays only move while every stripe is locked, so a record that fits in them only needs the lock of its own stripe
+  if (!has_joints_ || id >= capacity_ || has_mapped_states_)
+  {
+    const auto locks = lockAll();
+    prepareHelper(id, record);
+  }
+
+  std::lock_guard<std::mutex> lock {getStripe(id)};
+  putHelper(id, record, interpolated);
+}
+
+void ReachDatabase::reserve(const std::size_t n)
+{
+  const auto locks = lockAll();
+  if (n > positions_.size())
+  {
+    if (has_mapped_states_)
+    {
+      materializeHelper();
+    }
+    growHelper(n);
+  }
+}
+
+void ReachDatabase::prepareHelper(const std::size_t id, const reach_msgs::ReachRecord &record)
+{
+  if (has_mapped_states_)
+  {
+    materializeHelper();
+  }
+
+  // The first record defines the joints of the database
+  if (!has_joints_)
+  {
+    joint_names_ = record.goal_state.name;
+    seed_states_.assign(positions_.size() * joint_names_.size(), 0.0);
+    goal_states_.assign(positions_.size() * joint_names_.size(), 0.0);
+    has_joints_ = true;
+  }
+
+  // Grow geometrically so that adding records in order of ID does not lock the whole database for every record
+  if (id >= positions_.size())
+  {
+    growHelper(std::max(id + 1, 2 * positions_.size()));
+  }
+}
+
+void ReachDatabase::growHelper(const std::size_t n)
+{
+  const std::size_t n_joints = joint_names_.size();
+  positions_.resize(n, NO_POSITION);
+  reached_.resize(n, 0);
+  interpolated_.resize(n, 0);
+  scores_.resize(n, 0.0);
+  goals_.resize(n * POSE_SIZE, 0.0);
+  versions_.resize(n, 0);
+  if (!has_mapped_states_)
+  {
+    seed_states_.resize(n * n_joints, 0.0);
+    goal_states_.resize(n * n_joints, 0.0);
+  }
+  capacity_ = n;
+}
+
+void ReachDatabase::materializeHelper()
+{
+  const std::size_t n_joints = joint_names_.size();
+  const std::size_t n_mapped = n_mapped_slots_ * n_joints;
+  seed_states_.assign(positions_.size() * n_joints, 0.0);
+  goal_states_.assign(positions_.size() * n_joints, 0.0);
+  std::copy(mapped_seed_states_, mapped_seed_states_ + n_mapped, seed_states_.begin());
+  std::copy(mapped_goal_states_, mapped_goal_states_ + n_mapped, goal_states_.begin());
+
+  has_mapped_states_ = false;
+  mapped_seed_states_ = nullptr;
+  mapped_goal_states_ = nullptr;
+  n_mapped_slots_ = 0;
+  mapped_file_.reset();
+}
+
+const double* ReachDatabase::getSeedStateHelper(const std::size_t id) const
+{
+  const std::size_t offset = id * joint_names_.size();
+  return has_mapped_states_ ? mapped_seed_states_ + offset : seed_states_.data() + offset;
+}
+
+const double* ReachDatabase::getGoalStateHelper(const std::size_t id) const
+{
+  const std::size_t offset = id * joint_names_.size();
+  return has_mapped_states_ ? mapped_goal_states_ + offset : goal_states_.data() + offset;
+}
+
+void ReachDatabase::putHelper(const std::size_t id, const reach_msgs::ReachRecord &record, const bool interpolated)
+{
+  const std::size_t n_joints = joint_names_.size();
+
+  // Copy the joint states first, so that an invalid record leaves the database unchanged
+  std::vector<double> seed_state (n_joints), goal_state (n_joints);
+  copyJointPositions(record.seed_state, joint_names_, seed_state.data());
+  copyJointPositions(record.goal_state, joint_names_, goal_state.data());
+
+  ScoreStatistics& statistics = stripes_[id % N_STRIPES].statistics;
+
+  // New records are appended to the positional index
+  if (positions_[id] == NO_POSITION)
+  {
+    std::lock_guard<std::mutex> lock {index_mutex_};
+    positions_[id] = ids_.size();
+    ids_.push_back(id);
+  }
+  else
+  {
+    statistics.update(reached_[id], scores_[id], -1);
+  }
+  statistics.update(record.reached, record.score, 1);
+
+  reached_[id] = record.reached;
+  // A record that is written without the interpolated flag has been solved directly
+  interpolated_[id] = interpolated;
+  scores_[id] = record.score;
+
+  double* goal = &goals_[id * POSE_SIZE];
+  goal[0] = record.goal.position.x;
+  goal[1] = record.goal.position.y;
+  goal[2] = record.goal.position.z;
+  goal[3] = record.goal.orientation.x;
+  goal[4] = record.goal.orientation.y;
+  goal[5] = record.goal.orientation.z;
+  goal[6] = record.goal.orientation.w;
+
+  std::copy(seed_state.begin(), seed_state.end(), seed_states_.begin() + id * n_joints);
+  std::copy(goal_state.begin(), goal_state.end(), goal_states_.begin() + id * n_joints);
+  versions_[id] = ++version_;
+
+  // Entries are buffered by the stripe while it is locked, so that the changes of each record are logged in the order they were made
+  // without every writer contending for the log queue; the log writer collects the buffers in batches
+  if (logging_)
+  {
+    encodeLogEntryHelper(id, stripes_[id % N_STRIPES].log_entries);
+  }
+}
+
+reach_msgs::ReachRecord ReachDatabase::getHelper(const std::size_t id) const
+{
+  const std::size_t n_joints = joint_names_.size();
+
+  reach_msgs::ReachRecord r;
+  r.id = std::to_string(id);
+  r.reached = reached_[id];
+  r.score = scores_[id];
+
+  const double* goal = &goals_[id * POSE_SIZE];
+  r.goal.position.x = goal[0];
+  r.goal.position.y = goal[1];
+  r.goal.position.z = goal[2];
+  r.goal.orientation.x = goal[3];
+  r.goal.orientation.y = goal[4];
+  r.goal.orientation.z = goal[5];
+  r.goal.orientation.w = goal[6];
+
+  r.seed_state.name = joint_names_;
+  const double* seed_state = getSeedStateHelper(id);
+  r.seed_state.position.assign(seed_state, seed_state + n_joints);
+  r.goal_state.name = joint_names_;
+  const double* goal_state = getGoalStateHelper(id);
+  r.goal_state.position.assign(goal_state, goal_state + n_joints);
+
+  return r;
+}
+
+bool ReachDatabase::hasHelper(const std::size_t id) const
+{
+  return id < positions_.size() && positions_[id] != NO_POSITION;
+}
+
+std::size_t ReachDatabase::nextHelper(std::size_t id) const
+{
+  // Each ID is checked under the lock of its own stripe, so that iterating does not block writers
+  for (;; ++id)
+  {
+    std::lock_guard<std::mutex> lock {getStripe(id)};
+    if (id >= positions_.size())
+    {
+      return END_ID;
+    }
+    if (positions_[id] != NO_POSITION)
+    {
+      return id;
+    }
+  }
+}
+
+bool ReachDatabase::contains(const std::size_t id) const
+{
+  std::lock_guard<std::mutex> lock {getStripe(id)};
+  return hasHelper(id);
+}
+
+std::size_t ReachDatabase::getIDAt(const std::size_t position) const
+{
+  std::lock_guard<std::mutex> lock {index_mutex_};
+  return ids_.at(position);
+}
+
+boost::optional<std::size_t> ReachDatabase::getPositionOf(const std::size_t id) const
+{
+  std::lock_guard<std::mutex> lock {getStripe(id)};
+  if (hasHelper(id))
+  {
+    return positions_[id];
+  }
+  return {};
+}
+
+geometry_msgs::Point ReachDatabase::getGoalPosition(const std::size_t id) const
+{
+  std::lock_guard<std::mutex> lock {getStripe(id)};
+  if (!hasHelper(id))
+  {
+    throw std::out_of_range("No reach record with ID " + std::to_string(id));
+  }
+
+  geometry_msgs::Point pt;
+  pt.x = goals_[id * POSE_SIZE];
+  pt.y = goals_[id * POSE_SIZE + 1];
+  pt.z = goals_[id * POSE_SIZE + 2];
+  return pt;
+}
+
+std::uint64_t ReachDatabase::getVersion(const std::size_t id) const
+{
+  std::lock_guard<std::mutex> lock {getStripe(id)};
+  return hasHelper(id) ? versions_[id] : 0;
+}
+
+bool ReachDatabase::isReached(const std::size_t id) const
+{
+  std::lock_guard<std::mutex> lock {getStripe(id)};
+  return hasHelper(id) && reached_[id];
+}
+
+bool ReachDatabase::isInterpolated(const std::string &id) const
+{
+  std::size_t i;
+  if (!parseID(id, i))
+  {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock {getStripe(i)};
+  return hasHelper(i) && interpolated_[i];
+}
+
+std::vector<std::string> ReachDatabase::getInterpolatedIDs() const
+{
+  const auto locks = lockAll();
+  std::vector<std::string> ids;
+  for (std::size_t i = 0; i < positions_.size(); ++i)
+  {
+    if (hasHelper(i) && interpolated_[i])
+    {
+      ids.push_back(std::to_string(i));
+    }
+  }
+  return ids;
+}
+
+std::size_t ReachDatabase::size() const
+{
+  std::lock_guard<std::mutex> lock {index_mutex_};
+  return ids_.size();
+}
+
+std::vector<RecordView> ReachDatabase::query(const ReachQuery& query) const
+{
+  std::vector<RecordView> views;
+  if (query.limit == 0)
+  {
+    return views;
+  }
+
+  const bool has_score_bounds = query.min_score > -std::numeric_limits<double>::infinity() ||
+                                query.max_score < std::numeric_limits<double>::infinity();
+  if (query.order == ReachQuery::Order::ID && !has_score_bounds)
+  {
+    // Scan the IDs in range; each ID is checked under the lock of its own stripe, as when iterating
+    for (std::size_t id = query.min_id; id <= query.max_id && id < capacity_ && views.size() < query.limit; ++id)
+    {
+      RecordView view;
+      std::lock_guard<std::mutex> lock {getStripe(id)};
+      if (matchHelper(id, query, view))
+      {
+        views.push_back(view);
+      }
+    }
+    return views;
+  }
+
+  // Collect the candidates within the score bounds from the index, then check the full query against the current state of each record
+  std::vector<std::pair<double, std::size_t>> candidates;
+  {
+    std::lock_guard<std::mutex> lock {score_index_mutex_};
+    updateScoreIndexHelper();
+
+    const auto begin = std::lower_bound(score_index_.begin(), score_index_.end(),
+                                        std::make_pair(query.min_score, std::size_t(0)));
+    const auto end = std::upper_bound(begin, score_index_.end(),
+                                      std::make_pair(query.max_score, std::numeric_limits<std::size_t>::max()));
+    std::copy_if(begin, end, std::back_inserter(candidates), [&query](const std::pair<double, std::size_t>& c) {
+      return c.second >= query.min_id && c.second <= query.max_id;
+    });
+  }
+
+  if (query.order == ReachQuery::Order::SCORE_DESCENDING)
+  {
+    // Equal scores remain in ascending order of ID
+    std::reverse(candidates.begin(), candidates.end());
+    for (auto first = candidates.begin(); first != candidates.end();)
+    {
+      const auto last = std::find_if(first, candidates.end(), [first](const std::pair<double, std::size_t>& c) {
+        return c.first != first->first;
+      });
+      std::reverse(first, last);
+      first = last;
+    }
+  }
+
+  // Results ordered by ID need every match; results ordered by score stop at the limit
+  const std::size_t limit = query.order == ReachQuery::Order::ID ? std::numeric_limits<std::size_t>::max() : query.limit;
+  for (auto it = candidates.begin(); it != candidates.end() && views.size() < limit; ++it)
+  {
+    RecordView view;
+    std::lock_guard<std::mutex> lock {getStripe(it->second)};
+    if (matchHelper(it->second, query, view))
+    {
+      views.push_back(view);
+    }
+  }
+
+  // Records may have changed since the index was built
+  if (query.order == ReachQuery::Order::ID)
+  {
+    std::sort(views.begin(), views.end(), [](const RecordView& a, const RecordView& b) { return a.id < b.id; });
+  }
+  else
+  {
+    const bool ascending = query.order == ReachQuery::Order::SCORE_ASCENDING;
+    std::stable_sort(views.begin(), views.end(), [ascending](const RecordView& a, const RecordView& b) {
+      return a.score != b.score ? (ascending ? a.score < b.score : a.score > b.score) : a.id < b.id;
+    });
+  }
+
+  if (views.size() > query.limit)
+  {
+    views.resize(query.limit);
+  }
+  return views;
+}
+
+bool ReachDatabase::matchHelper(const std::size_t id, const ReachQuery& query, RecordView& view) const
+{
+  if (!hasHelper(id))
+  {
+    return false;
+  }
+
+  view.id = id;
+  view.reached = reached_[id];
+  view.interpolated = interpolated_[id];
+  view.score = scores_[id];
+  view.position.x = goals_[id * POSE_SIZE];
+  view.position.y = goals_[id * POSE_SIZE + 1];
+  view.position.z = goals_[id * POSE_SIZE + 2];
+
+  if ((query.reached && *query.reached != view.reached) || (query.interpolated && *query.interpolated != view.interpolated))
+  {
+    return false;
+  }
+
+  if (view.score < query.min_score || view.score > query.max_score)
+  {
+    return false;
+  }
+
+  if (query.box)
+  {
+    const geometry_msgs::Point& min = query.box->min;
+    const geometry_msgs::Point& max = query.box->max;
+    if (view.position.x < min.x || view.position.x > max.x || view.position.y < min.y || view.position.y > max.y ||
+        view.position.z < min.z || view.position.z > max.z)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void ReachDatabase::updateScoreIndexHelper() const
+{
+  if (score_index_version_ == version_)
+  {
+    return;
+  }
+
+  // Collect the scores under exclusive access, so that the index and its version match, and sort them afterwards
+  {
+    const auto locks = lockAll();
+    score_index_version_ = version_;
+    score_index_.clear();
+    score_index_.reserve(ids_.size());
+    for (const std::size_t id : ids_)
+    {
+      score_index_.emplace_back(scores_[id], id);
+    }
+  }
+  std::sort(score_index_.begin(), score_index_.end());
+}
+
+StudyResults ReachDatabase::getStudyResults() const
+{
+  return getStudyResultsHelper(getScoreStatistics());
+}
+
+StudyResults ReachDatabase::getStudyResultsHelper(const ScoreStatistics& statistics) const
+{
+  StudyResults results = results_;
+  if (statistics.n_records > 0)
+  {
+    const float pct_success = static_cast<float>(statistics.n_reached) / static_cast<float>(statistics.n_records);
+    results.reach_percentage = 100.0f * pct_success;
+    results.total_pose_score = statistics.total_score;
+    results.norm_total_pose_score = statistics.n_reached > 0 ? statistics.total_score / pct_success : 0.0f;
+  }
+  return results;
+}
+
+ScoreStatistics ReachDatabase::getScoreStatistics() const
+{
+  // Each stripe is only locked while its aggregates are copied, so that writers of other stripes are not blocked
+  ScoreStatistics statistics;
+  for (Stripe& stripe : stripes_)
+  {
+    std::lock_guard<std::mutex> lock {stripe.mutex};
+    statistics += stripe.statistics;
+  }
+  return statistics;
+}
+
+void ReachDatabase::printResults()
+{
+  const ScoreStatistics statistics = getScoreStatistics();
+  const StudyResults results = getStudyResultsHelper(statistics);
+  ROS_INFO("------------------------------------------------");
+  ROS_INFO_STREAM("Percent Reached = " << results.reach_percentage);
+  ROS_INFO_STREAM("Total points score = " << results.total_pose_score);
+  ROS_INFO_STREAM("Normalized total points score = " << results.norm_total_pose_score);
+  ROS_INFO_STREAM("Score (min / median / max) = " << statistics.getMinimum() << " / " << statistics.getPercentile(50.0) << " / "
+                  << statistics.getMaximum());
+  ROS_INFO_STREAM("Neighbor analysis = " << (results.neighbor_analysis.empty() ? "none" : results.neighbor_analysis));
+  ROS_INFO_STREAM("Average reachable neighbors = " << results.avg_num_neighbors);
+  ROS_INFO_STREAM("Average joint distance = " << results.avg_joint_distance);
+  ROS_INFO_STREAM("------------------------------------------------");
+}
+
+ReachDatabase::const_iterator ReachDatabase::begin() const
+{
+  return const_iterator(this, nextHelper(0));
+}
+
+ReachDatabase::const_iterator ReachDatabase::end() const
+{
+  return const_iterator(this, END_ID);
+}
+
+reach_msgs::ReachDatabase ReachDatabase::toReachDatabaseMsg() const
+{
+  const auto locks = lockAll();
+  return toReachDatabaseHelper();
+}
+
+reach_msgs::ReachDatabase ReachDatabase::toReachDatabaseHelper() const
+{
+  reach_msgs::ReachDatabase msg;
+  msg.records.reserve(ids_.size());
+  for (std::size_t i = 0; i < positions_.size(); ++i)
+  {
+    if (hasHelper(i))
+    {
+      msg.records.push_back(getHelper(i));
+    }
+  }
+
+  // Every stripe is locked by the caller
+  ScoreStatistics statistics;
+  for (const Stripe& stripe : stripes_)
+  {
+    statistics += stripe.statistics;
+  }
+  const StudyResults results = getStudyResultsHelper(statistics);
+
+  msg.total_pose_score = results.total_pose_score;
+  msg.norm_total_pose_score = results.norm_total_pose_score;
+  msg.reach_percentage = results.reach_percentage;
+  msg.avg_num_neighbors = results.avg_num_neighbors;
+  msg.avg_joint_distance = results.avg_joint_distance;
+
+  return msg;
+}
+
+} // namespace core
+} // namespace reach
@@ -14,14 +14,26 @@
  * limitations under the License.
  */
 #include <reach_core/reach_study.h>
+#include <reach_core/component_analysis.h>
 #include <reach_core/utils/serialization_utils.h>
 #include <reach_core/utils/general_utils.h>
 
 #include <reach_msgs/LoadPointCloud.h>
 #include <reach_msgs/ReachRecord.h>
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <map>
+#include <mutex>
 #include <numeric>
+#include <sstream>
+#include <thread>
+#include <tuple>
 #include <eigen_conversions/eigen_msg.h>
+#include <pcl/kdtree/kdtree_flann.h>
 #include <pluginlib/class_loader.h>
 #include <ros/package.h>
 #include <xmlrpcpp/XmlRpcException.h>
@@ -31,12 +43,361 @@ const static double SRV_TIMEOUT = 5.0;
 const static std::string INPUT_CLOUD_TOPIC = "input_cloud";
 const static std::string SAVED_DB_NAME = "reach.db";
 const static std::string OPT_SAVED_DB_NAME = "optimized_reach.db";
+const static std::string CHECKPOINT_DB_NAME = "reach.db.checkpoint";
+const static std::string OPT_CHECKPOINT_DB_NAME = "optimized_reach.db.checkpoint";
+const static std::string NEIGHBOR_GRAPH_NAME = "reach.db.neighbors";
+const static std::string PREV_DB_SUFFIX = ".prev";
+
+namespace
+{
+
+/**
+ * @brief The Checkpointer class periodically saves a snapshot of the reach database to file from a background thread, so that the
+ * progress of a long-running study survives crashes and interruptions without stalling the threads that write to the database
+ */
+class Checkpointer
+{
+public:
+
+  Checkpointer(reach::core::ReachDatabasePtr db,
+               const std::string& filename,
+               const double interval)
+    : db_(db)
+    , filename_(filename)
+    , stop_(false)
+  {
+    if(interval > 0.0)
+    {
+      thread_ = std::thread(&Checkpointer::run, this, std::chrono::duration<double>(interval));
+    }
+  }
+
+  ~Checkpointer()
+  {
+    {
+      std::lock_guard<std::mutex> lock {mutex_};
+      stop_ = true;
+    }
+    cv_.notify_all();
+
+    if(thread_.joinable())
+    {
+      thread_.join();
+    }
+  }
+
+private:
+
+  void run(const std::chrono::duration<double> interval)
+  {
+    std::unique_lock<std::mutex> lock {mutex_};
+    while(!cv_.wait_for(lock, interval, [this]() { return stop_; }))
+    {
+      try
+      {
+        db_->save(filename_);
+        ROS_INFO_STREAM("Saved checkpoint of " << db_->size() << " records (" << db_->getStudyResults().reach_percentage << "% reached)");
+      }
+      catch(const std::exception& ex)
+      {
+        ROS_WARN_STREAM("Failed to save checkpoint: " << ex.what());
+      }
+    }
+  }
+
+  reach::core::ReachDatabasePtr db_;
+  const std::string filename_;
+
+  bool stop_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread thread_;
+};
+
+/**
+ * @brief getSeedingFronts orders the unsolved points of the cloud into successive fronts by breadth-first traversal of the
+ * radius-neighborhood graph, such that every point (other than the starting points) has a neighbor in an earlier front from which it can
+ * be seeded. Traversal starts from the neighbors of points that have already been solved (e.g. when resuming from a checkpoint), and
+ * from a number of randomly chosen points in each region of the cloud that is not connected to any solved point
+ * @param cloud
+ * @param search_tree search tree over the cloud
+ * @param unsolved indices of the points that remain to be solved
+ * @param radius neighborhood radius
+ * @param n_starts number of points from which to start traversing an unconnected region
+ * @return
+ */
+std::vector<std::vector<std::size_t>> getSeedingFronts(const pcl::PointCloud<pcl::PointNormal>& cloud,
+                                                       const pcl::KdTreeFLANN<pcl::PointNormal>& search_tree,
+                                                       const std::vector<std::size_t>& unsolved,
+                                                       const double radius,
+                                                       const std::size_t n_starts)
+{
+  std::vector<char> pending (cloud.size(), 0);
+  for(const std::size_t i : unsolved)
+  {
+    pending[i] = 1;
+  }
+
+  std::vector<int> nn_indices;
+  std::vector<float> nn_distances;
+
+  // Start from the unsolved neighbors of the points that have already been solved
+  std::vector<std::size_t> front;
+  for(std::size_t i = 0; i < cloud.size(); ++i)
+  {
+    if(!pending[i])
+    {
+      search_tree.radiusSearch(cloud.points[i], radius, nn_indices, nn_distances);
+      for(const int n : nn_indices)
+      {
+        if(pending[n])
+        {
+          pending[n] = 0;
+          front.push_back(static_cast<std::size_t>(n));
+        }
+      }
+    }
+  }
+
+  // Candidate starting points for unconnected regions, in random order so that they are spread across the cloud
+  std::vector<std::size_t> starts (unsolved);
+  std::random_shuffle(starts.begin(), starts.end());
+  auto start_it = starts.begin();
+
+  std::vector<std::vector<std::size_t>> fronts;
+  while(true)
+  {
+    if(front.empty())
+    {
+      for(; start_it != starts.end() && front.size() < n_starts; ++start_it)
+      {
+        if(pending[*start_it])
+        {
+          pending[*start_it] = 0;
+          front.push_back(*start_it);
+        }
+      }
+
+      if(front.empty())
+      {
+        break;
+      }
+    }
+
+    std::vector<std::size_t> next_front;
+    for(const std::size_t i : front)
+    {
+      search_tree.radiusSearch(cloud.points[i], radius, nn_indices, nn_distances);
+      for(const int n : nn_indices)
+      {
+        if(pending[n])
+        {
+          pending[n] = 0;
+          next_front.push_back(static_cast<std::size_t>(n));
+        }
+      }
+    }
+
+    fronts.push_back(std::move(front));
+    front = std::move(next_front);
+  }
+
+  return fronts;
+}
+
+/**
+ * @brief voxelize groups the input points of the cloud by the cubic voxel that contains them. The first point of each voxel is its
+ * representative, which is the point closest to the centroid of the voxel's points
+ * @param cloud
+ * @param indices indices of the points to group
+ * @param voxel_size edge length of the voxels
+ * @return the indices of the points in each voxel, keyed by the integer coordinates of the voxel
+ */
+std::map<std::array<long, 3>, std::vector<std::size_t>> voxelize(const pcl::PointCloud<pcl::PointNormal>& cloud,
+                                                                 const std::vector<std::size_t>& indices,
+                                                                 const double voxel_size)
+{
+  std::map<std::array<long, 3>, std::vector<std::size_t>> voxels;
+  for(const std::size_t i : indices)
+  {
+    const pcl::PointNormal& pt = cloud.points[i];
+    const std::array<long, 3> key = {{static_cast<long>(std::floor(pt.x / voxel_size)),
+                                      static_cast<long>(std::floor(pt.y / voxel_size)),
+                                      static_cast<long>(std::floor(pt.z / voxel_size))}};
+    voxels[key].push_back(i);
+  }
+
+  for(auto& pair : voxels)
+  {
+    std::vector<std::size_t>& pts = pair.second;
+
+    Eigen::Vector3f centroid = Eigen::Vector3f::Zero();
+    for(const std::size_t i : pts)
+    {
+      centroid += cloud.points[i].getVector3fMap();
+    }
+    centroid /= static_cast<float>(pts.size());
+
+    auto rep = std::min_element(pts.begin(), pts.end(), [&](const std::size_t a, const std::size_t b) {
+      return (cloud.points[a].getVector3fMap() - centroid).squaredNorm() < (cloud.points[b].getVector3fMap() - centroid).squaredNorm();
+    });
+    std::iter_swap(pts.begin(), rep);
+  }
+
+  return voxels;
+}
+
+/**
+ * @brief getBatchSize returns the number of points to solve per batched IK call, such that each worker still receives several batches to
+ * balance the load
+ * @param n number of points to solve
+ * @param n_workers
+ * @return
+ */
+std::size_t getBatchSize(const std::size_t n,
+                         const std::size_t n_workers)
+{
+  const static std::size_t MAX_IK_BATCH_SIZE = 16;
+  return std::max<std::size_t>(1, std::min<std::size_t>(MAX_IK_BATCH_SIZE, n / (4 * n_workers)));
+}
+
+/**
+ * @brief createTargetFrame creates the target pose of the robot for a point of the cloud, with the tool Z axis opposing the surface normal
+ * @param pt
+ * @return
+ */
+Eigen::Isometry3d createTargetFrame(const pcl::PointNormal& pt)
+{
+  // Rotation to flip the Z axis of the surface normal point
+  const Eigen::AngleAxisd tool_z_rot(M_PI, Eigen::Vector3d::UnitY());
+
+  Eigen::Isometry3d tgt_frame;
+  tgt_frame = reach::utils::createFrame(pt.getArray3fMap(), pt.getNormalVector3fMap());
+  return tgt_frame * tool_z_rot;
+}
+
+} // namespace anonymous
 
 namespace reach
 {
 namespace core
 {
 
+std::vector<std::vector<std::vector<std::size_t>>> partitionIntoPhases(const ReachDatabase& db,
+                                                                        const double radius)
+{
+  const double cell_size = 2.0 * radius;
+
+  std::vector<std::map<std::array<long, 3>, std::vector<std::size_t>>> cell_maps (8);
+  for(std::size_t p = 0; p < db.size(); ++p)
+  {
+    const std::size_t id = db.getIDAt(p);
+    const geometry_msgs::Point pt = db.getGoalPosition(id);
+
+    const std::array<long, 3> key = {{static_cast<long>(std::floor(pt.x / cell_size)),
+                                      static_cast<long>(std::floor(pt.y / cell_size)),
+                                      static_cast<long>(std::floor(pt.z / cell_size))}};
+    const std::size_t phase = (key[0] & 1) | ((key[1] & 1) << 1) | ((key[2] & 1) << 2);
+    cell_maps[phase][key].push_back(id);
+  }
+
+  std::vector<std::vector<std::vector<std::size_t>>> phases (cell_maps.size());
+  for(std::size_t i = 0; i < cell_maps.size(); ++i)
+  {
+    phases[i].reserve(cell_maps[i].size());
+    for(auto& pair : cell_maps[i])
+    {
+      phases[i].push_back(std::move(pair.second));
+    }
+  }
+
+  return phases;
+}
+
+boost::optional<std::size_t> prepareOptimization(ReachDatabase& db,
+                                                 const std::string& db_filename,
+                                                 const std::string& checkpoint_filename,
+                                                 const std::function<void()>& verify)
+{
+  // Verifying updates the initial study database, so it must not be combined with a checkpoint that was made from the unverified records
+  if(verify && !db.getInterpolatedIDs().empty())
+  {
+    verify();
+    db.save(db_filename);
+    ReachDatabase::remove(checkpoint_filename);
+    return boost::none;
+  }
+
+  if(!db.load(checkpoint_filename))
+  {
+    return boost::none;
+  }
+
+  return db.replayLog(checkpoint_filename);
+}
+
+std::vector<int> matchPoints(utils::TaskPool& pool,
+                             const pcl::PointCloud<pcl::PointNormal>::ConstPtr& prev_cloud,
+                             const pcl::PointCloud<pcl::PointNormal>::ConstPtr& cloud,
+                             const double position_tolerance,
+                             const double angle_tolerance)
+{
+  std::vector<int> matches (cloud->points.size(), -1);
+  if(prev_cloud->points.empty() || cloud->points.empty())
+  {
+    return matches;
+  }
+
+  pcl::KdTreeFLANN<pcl::PointNormal> kd_tree;
+  kd_tree.setInputCloud(prev_cloud);
+
+  // Collect the candidate previous points of each point: those within the position tolerance whose normal is within the angle tolerance
+  const float min_cos = static_cast<float>(std::cos(angle_tolerance));
+  std::vector<std::vector<std::pair<float, int>>> candidates (cloud->points.size());
+  pool.parallelFor(cloud->points.size(), [&](const std::size_t i, const std::size_t)
+  {
+    const pcl::PointNormal& pt = cloud->points[i];
+
+    std::vector<int> nn_indices;
+    std::vector<float> nn_distances;
+    kd_tree.radiusSearch(pt, position_tolerance, nn_indices, nn_distances);
+    for(std::size_t j = 0; j < nn_indices.size(); ++j)
+    {
+      const int n = nn_indices[j];
+      if(prev_cloud->points[n].getNormalVector3fMap().dot(pt.getNormalVector3fMap().normalized()) >= min_cos)
+      {
+        candidates[i].emplace_back(nn_distances[j], n);
+      }
+    }
+  });
+
+  // Assign the candidate pairs in order of increasing distance, so that several points near the same previous point do not all copy its
+  // record; ties are broken by index to keep the assignment deterministic
+  std::vector<std::tuple<float, std::size_t, int>> pairs;
+  for(std::size_t i = 0; i < candidates.size(); ++i)
+  {
+    for(const std::pair<float, int>& c : candidates[i])
+    {
+      pairs.emplace_back(c.first, i, c.second);
+    }
+  }
+  std::sort(pairs.begin(), pairs.end());
+
+  std::vector<char> claimed (prev_cloud->points.size(), 0);
+  for(const std::tuple<float, std::size_t, int>& pair : pairs)
+  {
+    const std::size_t i = std::get<1>(pair);
+    const int n = std::get<2>(pair);
+    if(matches[i] < 0 && !claimed[n])
+    {
+      matches[i] = n;
+      claimed[n] = 1;
+    }
+  }
+
+  return matches;
+}
+
 static const std::string PACKAGE = "reach_core";
 static const std::string IK_BASE_CLASS = "reach::plugins::IKSolverBase";
 static const std::string DISPLAY_BASE_CLASS = "reach::plugins::DisplayBase";
@@ -81,6 +442,14 @@ bool ReachStudy::initializeStudy()
 
   display_->showEnvironment();
 
+  // Create the worker threads of the study, each with an independent IK solver
+  pool_.reset(new utils::TaskPool(static_cast<std::size_t>(std::max(sp_.max_threads, 0))));
+  if(!createSolverPool(pool_->size()))
+  {
+    ROS_ERROR("Failed to create the pool of IK solvers");
+    return false;
+  }
+
   // Create a directory to store results of study
   if(!sp_.results_directory.empty() && boost::filesystem::exists(sp_.results_directory.c_str()))
   {
@@ -103,10 +472,50 @@ bool ReachStudy::initializeStudy()
   return true;
 }
 
+bool ReachStudy::createSolverPool(const std::size_t n)
+{
+  solver_pool_.clear();
+  solver_pool_.reserve(n);
+
+  for(std::size_t i = 0; i < n; ++i)
+  {
+    // Prefer cloning the initialized solver, since it avoids reloading the robot model and collision geometry
+    reach::plugins::IKSolverBasePtr solver = ik_solver_->clone();
+    if(!solver)
+    {
+      // Otherwise create and initialize a new instance of the plugin
+      try
+      {
+        solver = solver_loader_.createInstance(sp_.ik_solver_config["name"]);
+      }
+      catch(const XmlRpc::XmlRpcException& ex)
+      {
+        ROS_ERROR_STREAM(ex.getMessage());
+        return false;
+      }
+      catch(const pluginlib::PluginlibException& ex)
+      {
+        ROS_ERROR_STREAM(ex.what());
+        return false;
+      }
+
+      if(!solver->initialize(sp_.ik_solver_config))
+      {
+        return false;
+      }
+    }
+
+    solver_pool_.push_back(std::move(solver));
+  }
+
+  return true;
+}
+
 bool ReachStudy::run(const StudyParameters& sp)
 {
   // Overrwrite the old study parameters
   sp_ = sp;
+  db_->setCompression(sp_.compression);
 
   // Initialize the study
   if(!initializeStudy())
@@ -129,8 +538,28 @@ bool ReachStudy::run(const StudyParameters& sp)
     pub.publish(cloud_msg_);
   }
 
+  // Create the index of the goal positions of the records, which the visualizer and the optimization use to find neighbors
+  spatial_index_ = makeSpatialIndex(sp_.optimization.spatial_index, sp_.optimization.radius);
+  if(!spatial_index_)
+  {
+    ROS_ERROR_STREAM("Unknown spatial index type '" << sp_.optimization.spatial_index << "'");
+    return false;
+  }
+
+  // Share the results of the neighbor IK transitions between the optimization, the neighbor analysis and the visualizer
+  if(sp_.optimization.transition_cache_size > 0)
+  {
+    transition_cache_ = std::make_shared<TransitionCache>(static_cast<std::size_t>(sp_.optimization.transition_cache_size));
+  }
+
   // Create markers
-  visualizer_.reset(new ReachVisualizer(db_, ik_solver_, display_, sp_.optimization.radius));
+  visualizer_.reset(new ReachVisualizer(db_, ik_solver_, display_, sp_.optimization.radius, spatial_index_, transition_cache_));
+
+  // Carry the results of a previous study over to the unchanged points of the current cloud
+  if(sp_.incremental.enable)
+  {
+    updatePreviousStudy();
+  }
 
   // Attempt to load previously saved optimized reach_study database
   if(!db_->load(results_dir_ + OPT_SAVED_DB_NAME))
@@ -142,8 +571,19 @@ bool ReachStudy::run(const StudyParameters& sp)
       ROS_INFO("No reach study database loaded");
       ROS_INFO("------------------------------");
 
+      // Resume from the checkpoint of a previously interrupted study, if one exists
+      if(db_->load(results_dir_ + CHECKPOINT_DB_NAME))
+      {
+        ROS_INFO("Resuming reach study from checkpoint with %lu of %lu points completed", db_->size(), cloud_->size());
+      }
+
       // Run the first pass of the reach study
-      runInitialReachStudy();
+      if(!runInitialReachStudy())
+      {
+        ROS_ERROR("Reach study interrupted; completed points have been saved to '%s'",
+                  (results_dir_ + CHECKPOINT_DB_NAME).c_str());
+        return false;
+      }
       db_->printResults();
       visualizer_->update();
     }
@@ -157,20 +597,27 @@ bool ReachStudy::run(const StudyParameters& sp)
       visualizer_->update();
     }
 
-    // Create an efficient search tree for doing nearest neighbors search
-    search_tree_.reset(new SearchTree(flann::KDTreeSingleIndexParams(1, true)));
-
-    flann::Matrix<double> dataset (new double[db_->size() * 3], db_->size(), 3);
-    for(std::size_t i = 0; i < db_->size(); ++i)
+    // Solve the points that an adaptive study labeled by interpolation, if requested, or resume an interrupted optimization from its last
+    // snapshot and the changes logged after it
+    std::function<void()> verify;
+    if(sp_.adaptive_sampling.verify_interpolated)
     {
-      auto it = db_->begin();
-      std::advance(it, i);
+      verify = [this]() { verifyInterpolatedRecords(); };
+    }
 
-      dataset[i][0] = static_cast<double>(it->second.goal.position.x);
-      dataset[i][1] = static_cast<double>(it->second.goal.position.y);
-      dataset[i][2] = static_cast<double>(it->second.goal.position.z);
+    const boost::optional<std::size_t> n_changes = prepareOptimization(*db_,
+                                                                       results_dir_ + SAVED_DB_NAME,
+                                                                       results_dir_ + OPT_CHECKPOINT_DB_NAME,
+                                                                       verify);
+    if(n_changes)
+    {
+      ROS_INFO("Resuming optimization from checkpoint (%lu logged changes recovered)", *n_changes);
     }
-    search_tree_->buildIndex(dataset);
+    db_->printResults();
+
+    // Index the records added by the initial study, and find the neighbors of every record once for all passes of the optimization
+    spatial_index_->update(*db_);
+    updateNeighborGraph();
 
     // Run the optimization
     optimizeReachStudyResults();
@@ -190,9 +637,21 @@ bool ReachStudy::run(const StudyParameters& sp)
   // Find the average number of neighboring points can be reached by the robot from any given point
   if(sp_.get_neighbors)
   {
-    // Perform the calculation if it hasn't already been done
-    if(db_->getStudyResults().avg_num_neighbors == 0.0f)
+    if(sp_.neighbor_analysis != "flood_fill" && sp_.neighbor_analysis != "components")
+    {
+      ROS_WARN_STREAM("Unknown neighbor analysis '" << sp_.neighbor_analysis << "'; using 'flood_fill'");
+      sp_.neighbor_analysis = "flood_fill";
+    }
+
+    // Perform the calculation if it hasn't already been done with the same method; the metrics of the methods are defined differently,
+    // so the results of one are not a substitute for the other
+    const std::string method = db_->getStudyResults().neighbor_analysis;
+    if(method != sp_.neighbor_analysis)
     {
+      if(!method.empty())
+      {
+        ROS_INFO_STREAM("Replacing the neighbor metrics computed by '" << method << "' analysis");
+      }
       getAverageNeighborsCount();
     }
   }
@@ -244,60 +703,523 @@ bool ReachStudy::getReachObjectPointCloud()
   return true;
 }
 
-void ReachStudy::runInitialReachStudy()
+void ReachStudy::updatePreviousStudy()
 {
-  // Rotation to flip the Z axis of the surface normal point
-  const Eigen::AngleAxisd tool_z_rot(M_PI, Eigen::Vector3d::UnitY());
+  // Prefer the optimized results of the previous study
+  ReachDatabase prev_db;
+  const bool optimized = prev_db.load(results_dir_ + OPT_SAVED_DB_NAME);
+  if(!optimized && !prev_db.load(results_dir_ + SAVED_DB_NAME))
+  {
+    return;
+  }
 
-  // Loop through all points in point cloud and get IK solution
-  std::atomic<int> current_counter, previous_pct;
-  current_counter = previous_pct = 0;
-  const int cloud_size = static_cast<int>(cloud_->points.size());
+  // Recover the point and surface normal of each previous record from its goal pose, whose Z axis opposes the normal
+  std::vector<reach_msgs::ReachRecord> prev_records;
+  prev_records.reserve(prev_db.size());
+  pcl::PointCloud<pcl::PointNormal>::Ptr prev_cloud (new pcl::PointCloud<pcl::PointNormal> ());
+  prev_cloud->points.reserve(prev_db.size());
+  for(auto it = prev_db.begin(); it != prev_db.end(); ++it)
+  {
+    const reach_msgs::ReachRecord rec = *it;
+
+    Eigen::Isometry3d goal;
+    tf::poseMsgToEigen(rec.goal, goal);
+    const Eigen::Vector3f normal = -goal.linear().col(2).cast<float>();
+
+    pcl::PointNormal pt;
+    pt.getVector3fMap() = goal.translation().cast<float>();
+    pt.getNormalVector3fMap() = normal;
+    prev_cloud->points.push_back(pt);
+    prev_records.push_back(rec);
+  }
+  prev_cloud->width = static_cast<uint32_t>(prev_cloud->points.size());
+  prev_cloud->height = 1;
 
-  #pragma omp parallel for
-  for(int i = 0; i < cloud_size; ++i)
+  // Match each point of the current cloud to a distinct previous point within the position and angle tolerances
+  const std::vector<int> matches = matchPoints(*pool_, prev_cloud, cloud_, sp_.incremental.position_tolerance,
+                                               sp_.incremental.angle_tolerance);
+
+  // Nothing to do if every point matches the previous record of the same ID
+  bool unchanged = prev_records.size() == cloud_->points.size();
+  for(std::size_t i = 0; unchanged && i < matches.size(); ++i)
+  {
+    unchanged = matches[i] >= 0 && prev_records[matches[i]].id == std::to_string(i);
+  }
+
+  if(unchanged)
+  {
+    ROS_INFO("Reach object point cloud is unchanged since the previous study");
+    return;
+  }
+
+  // Keep the results of the matched points under the IDs of the current cloud; the remaining points are solved by the initial study
+  std::vector<char> kept (prev_records.size(), 0);
+  revisit_.clear();
+  for(std::size_t i = 0; i < matches.size(); ++i)
   {
-    // Get pose from point cloud array
-    const pcl::PointNormal& pt = cloud_->points[i];
-    Eigen::Isometry3d tgt_frame;
-    tgt_frame = utils::createFrame(pt.getArray3fMap(), pt.getNormalVector3fMap());
-    tgt_frame = tgt_frame * tool_z_rot;
+    if(matches[i] < 0)
+    {
+      revisit_.push_back(i);
+      continue;
+    }
+
+    reach_msgs::ReachRecord rec = prev_records[matches[i]];
+    const bool interpolated = prev_db.isInterpolated(rec.id);
+    rec.id = std::to_string(i);
+    tf::poseEigenToMsg(createTargetFrame(cloud_->points[i]), rec.goal);
+    db_->put(rec, interpolated);
+    kept[matches[i]] = 1;
+  }
 
-    // Get the seed position
+  // Records of the previous study are only optimized with respect to each other, so unless the previous study was optimized the
+  // optimization has to revisit every point
+  if(!optimized)
+  {
+    revisit_.clear();
+  }
+
+  ROS_INFO("Reach object point cloud changed since the previous study: %lu points kept, %lu points new or moved, %ld points dropped",
+           db_->size(), cloud_->points.size() - db_->size(), std::count(kept.begin(), kept.end(), 0));
+
+  // Save a checkpoint of the kept records, from which the study resumes, and move the previous results to backups so that they no longer
+  // take precedence over the new results but are not lost
+  db_->save(results_dir_ + CHECKPOINT_DB_NAME);
+  for(const std::string& name : {OPT_SAVED_DB_NAME, SAVED_DB_NAME, OPT_CHECKPOINT_DB_NAME})
+  {
+    ReachDatabase::rename(results_dir_ + name, results_dir_ + name + PREV_DB_SUFFIX);
+  }
+}
+
+bool ReachStudy::loadCapabilityMap()
+{
+  // The map depends only on the robot, the planning group, and the settings of the map
+  std::string robot_description;
+  ros::param::get("robot_description", robot_description);
+
+  std::string planning_group;
+  try
+  {
+    if(sp_.ik_solver_config.hasMember("planning_group"))
+    {
+      planning_group = std::string(sp_.ik_solver_config["planning_group"]);
+    }
+  }
+  catch(const XmlRpc::XmlRpcException& ex)
+  {
+    ROS_ERROR_STREAM(ex.getMessage());
+    return false;
+  }
+
+  const std::string key = robot_description + "\n" + planning_group + "\n" + std::to_string(sp_.capability_map.n_samples);
+  std::stringstream filename;
+  filename << dir_ << "capability_map_" << std::hex << std::hash<std::string>()(key) << ".bin";
+
+  capability_map_.reset(new CapabilityMap(sp_.capability_map.resolution));
+  if(capability_map_->load(filename.str(), key))
+  {
+    ROS_INFO("Loaded capability map with %lu reachable voxels", capability_map_->size());
+    return true;
+  }
+
+  ROS_INFO("Building capability map from %d robot configurations", sp_.capability_map.n_samples);
+  if(!capability_map_->build(*pool_, solver_pool_, static_cast<std::size_t>(std::max(sp_.capability_map.n_samples, 0))))
+  {
+    ROS_WARN("IK solver plugin does not support sampling; unable to build capability map");
+    capability_map_.reset();
+    return false;
+  }
+
+  if(!capability_map_->save(filename.str(), key))
+  {
+    ROS_WARN_STREAM("Failed to save capability map to '" << filename.str() << "'");
+  }
+
+  ROS_INFO("Built capability map with %lu reachable voxels", capability_map_->size());
+  return true;
+}
+
+void ReachStudy::updateNeighborGraph()
+{
+  if(neighbor_graph_ && neighbor_graph_->matches(*db_, sp_.optimization.radius))
+  {
+    return;
+  }
+
+  // The graph only depends on the target points and the radius, so a graph saved by a previous run can be reused
+  const std::string filename = results_dir_ + NEIGHBOR_GRAPH_NAME;
+  neighbor_graph_.reset(new NeighborGraph());
+  if(neighbor_graph_->load(filename) && neighbor_graph_->matches(*db_, sp_.optimization.radius))
+  {
+    ROS_INFO("Loaded neighbor graph with %lu edges", neighbor_graph_->size());
+    visualizer_->setNeighborGraph(neighbor_graph_);
+    return;
+  }
+
+  neighbor_graph_->build(*pool_, *db_, *spatial_index_, sp_.optimization.radius);
+  if(!neighbor_graph_->save(filename))
+  {
+    ROS_WARN_STREAM("Failed to save neighbor graph to '" << filename << "'");
+  }
+
+  ROS_INFO("Built neighbor graph with %lu edges", neighbor_graph_->size());
+  visualizer_->setNeighborGraph(neighbor_graph_);
+}
+
+bool ReachStudy::runInitialReachStudy()
+{
+  // Allocate a record for every point up front so that the workers only lock the stripes of the records they write
+  db_->reserve(cloud_->points.size());
+
+  // Only solve the points that do not already have a record (i.e. when resuming from a checkpoint)
+  std::vector<std::size_t> indices;
+  indices.reserve(cloud_->points.size());
+  for(std::size_t i = 0; i < cloud_->points.size(); ++i)
+  {
+    if(!db_->contains(i))
+    {
+      indices.push_back(i);
+    }
+  }
+
+  // Mark the points in voxels that the robot cannot reach as unreachable without solving IK, and order the remaining points such that
+  // the points with the most reachable orientations are solved first
+  if(sp_.capability_map.enable && loadCapabilityMap())
+  {
     sensor_msgs::JointState seed_state;
     seed_state.name = ik_solver_->getJointNames();
     seed_state.position = std::vector<double>(seed_state.name.size(), 0.0);
 
-    // Solve IK
-    std::vector<double> solution;
-    boost::optional<double> score = ik_solver_->solveIKFromSeed(tgt_frame, jointStateMsgToMap(seed_state), solution);
+    std::vector<std::pair<float, std::size_t>> ranked;
+    ranked.reserve(indices.size());
+    for(const std::size_t i : indices)
+    {
+      const Eigen::Isometry3d tgt_frame = createTargetFrame(cloud_->points[i]);
+      const float reachability = capability_map_->getReachability(tgt_frame.translation());
+      if(reachability > 0.0f)
+      {
+        ranked.emplace_back(reachability, i);
+      }
+      else
+      {
+        geometry_msgs::Pose tgt_pose;
+        tf::poseEigenToMsg(tgt_frame, tgt_pose);
+        db_->put(makeRecord(std::to_string(i), false, tgt_pose, seed_state, seed_state, 0.0));
+      }
+    }
+
+    std::stable_sort(ranked.begin(), ranked.end(), [](const std::pair<float, std::size_t>& a, const std::pair<float, std::size_t>& b) {
+      return a.first > b.first;
+    });
+
+    ROS_INFO("Marked %lu points outside of the robot workspace as unreachable", indices.size() - ranked.size());
+
+    indices.clear();
+    for(const std::pair<float, std::size_t>& r : ranked)
+    {
+      indices.push_back(r.second);
+    }
+  }
+
+  // Loop through all points in point cloud and get IK solution
+  std::atomic<int> current_counter, previous_pct;
+  current_counter = previous_pct = 0;
+  const int cloud_size = static_cast<int>(indices.size());
+
+  // Create a search tree over the cloud for seeding each point from the solution of its nearest solved neighbor
+  pcl::KdTreeFLANN<pcl::PointNormal> kd_tree;
+  if(sp_.neighbor_seeding)
+  {
+    kd_tree.setInputCloud(cloud_);
+  }
+
+  // Solves IK for the input points of the cloud concurrently, in small batches. Each point is solved from the corresponding input seed
+  // (if any), or from the solution of a nearby reached point
+  auto solve = [&](const std::vector<std::size_t>& pts, const std::vector<std::vector<double>>& seeds)
+  {
+    const std::size_t batch_size = getBatchSize(pts.size(), pool_->size());
+    const std::size_t n_batches = (pts.size() + batch_size - 1) / batch_size;
+
+    pool_->parallelFor(n_batches, [&](const std::size_t b, const std::size_t worker)
+    {
+      // Skip the remaining points once shutdown has been requested
+      if(!ros::ok())
+      {
+        return;
+      }
 
+      const std::size_t first = b * batch_size;
+      const std::size_t last = std::min(first + batch_size, pts.size());
+      const std::vector<std::size_t> batch (pts.begin() + first, pts.begin() + last);
+
+      std::vector<std::vector<double>> batch_seeds;
+      batch_seeds.reserve(batch.size());
+      for(std::size_t j = first; j < last; ++j)
+      {
+        std::vector<double> seed_position = seeds.empty() ? std::vector<double>() : seeds[j];
+        if(seed_position.empty() && sp_.neighbor_seeding)
+        {
+          // Use the solution of the nearest neighbor that has already been reached
+          std::vector<int> nn_indices;
+          std::vector<float> nn_distances;
+          kd_tree.radiusSearch(cloud_->points[pts[j]], sp_.optimization.radius, nn_indices, nn_distances);
+          for(const int n : nn_indices)
+          {
+            boost::optional<reach_msgs::ReachRecord> neighbor = db_->get(static_cast<std::size_t>(n));
+            if(neighbor && neighbor->reached)
+            {
+              seed_position = neighbor->goal_state.position;
+              break;
+            }
+          }
+        }
+        batch_seeds.push_back(std::move(seed_position));
+      }
+
+      solveBatch(batch, batch_seeds, solver_pool_[worker]);
+
+      // Print function progress
+      current_counter += static_cast<int>(batch.size());
+      utils::integerProgressPrinter(current_counter, previous_pct, cloud_size);
+    });
+  };
+
+  {
+    // Periodically save the completed records while the study runs
+    Checkpointer checkpointer (db_, results_dir_ + CHECKPOINT_DB_NAME, sp_.checkpoint_interval);
+
+    if(sp_.adaptive_sampling.enable)
+    {
+      const double voxel_size = sp_.adaptive_sampling.voxel_size > 0.0f ? sp_.adaptive_sampling.voxel_size : sp_.optimization.radius;
+      const std::map<std::array<long, 3>, std::vector<std::size_t>> voxels = voxelize(*cloud_, indices, voxel_size);
+
+      // Solve the representative point of each voxel
+      std::vector<std::size_t> reps;
+      reps.reserve(voxels.size());
+      for(const auto& pair : voxels)
+      {
+        reps.push_back(pair.second.front());
+      }
+
+      ROS_INFO("Solving %lu voxel representatives of %d points", reps.size(), cloud_size);
+      solve(reps, {});
+
+      // Refine the voxels whose neighborhood contains both reachable and unreachable representatives, or representatives with widely
+      // varying scores. Label the points of all other voxels by interpolating the results of the neighborhood
+      std::vector<std::size_t> refine;
+      std::vector<std::vector<double>> refine_seeds;
+      for(const auto& pair : voxels)
+      {
+        if(!ros::ok())
+        {
+          break;
+        }
+
+        const std::vector<std::size_t>& pts = pair.second;
+        const reach_msgs::ReachRecord rep = *db_->get(pts.front());
+
+        std::vector<reach_msgs::ReachRecord> neighborhood;
+        for(long dx = -1; dx <= 1; ++dx)
+        {
+          for(long dy = -1; dy <= 1; ++dy)
+          {
+            for(long dz = -1; dz <= 1; ++dz)
+            {
+              const std::array<long, 3> key = {{pair.first[0] + dx, pair.first[1] + dy, pair.first[2] + dz}};
+              auto it = voxels.find(key);
+              if(it != voxels.end())
+              {
+                neighborhood.push_back(*db_->get(it->second.front()));
+              }
+            }
+          }
+        }
+
+        std::size_t n_reached = 0;
+        double sum = 0.0, sum_sq = 0.0;
+        for(const reach_msgs::ReachRecord& rec : neighborhood)
+        {
+          if(rec.reached)
+          {
+            ++n_reached;
+            sum += rec.score;
+            sum_sq += rec.score * rec.score;
+          }
+        }
+
+        bool interpolate = n_reached == 0 || n_reached == neighborhood.size();
+        if(interpolate && n_reached > 0)
+        {
+          const double mean = sum / n_reached;
+          const double std_dev = std::sqrt(std::max(sum_sq / n_reached - mean * mean, 0.0));
+          interpolate = std_dev <= sp_.adaptive_sampling.score_deviation_threshold * std::abs(mean);
+        }
+
+        for(std::size_t j = 1; j < pts.size(); ++j)
+        {
+          if(!interpolate)
+          {
+            refine.push_back(pts[j]);
+            refine_seeds.push_back(rep.reached ? rep.goal_state.position : std::vector<double>());
+            continue;
+          }
+
+          // Weight the scores of the reached representatives by their inverse distance to the point
+          const Eigen::Isometry3d tgt_frame = createTargetFrame(cloud_->points[pts[j]]);
+          double score = 0.0;
+          if(n_reached > 0)
+          {
+            double weight_sum = 0.0;
+            for(const reach_msgs::ReachRecord& rec : neighborhood)
+            {
+              const Eigen::Vector3d rec_pos (rec.goal.position.x, rec.goal.position.y, rec.goal.position.z);
+              const double weight = 1.0 / std::max((rec_pos - tgt_frame.translation()).norm(), 1.0e-6);
+              score += weight * rec.score;
+              weight_sum += weight;
+            }
+            score /= weight_sum;
+          }
+
+          geometry_msgs::Pose tgt_pose;
+          tf::poseEigenToMsg(tgt_frame, tgt_pose);
+
+          // The joint states of the representative are the best available estimate of the joint states at the point
+          auto msg = makeRecord(std::to_string(pts[j]), n_reached > 0, tgt_pose, rep.seed_state, rep.goal_state, score);
+          db_->put(msg, true);
+        }
+
+        if(interpolate)
+        {
+          current_counter += static_cast<int>(pts.size() - 1);
+          utils::integerProgressPrinter(current_counter, previous_pct, cloud_size);
+        }
+      }
+
+      ROS_INFO("Refining %lu points near reachability boundaries", refine.size());
+      solve(refine, refine_seeds);
+
+      if(sp_.adaptive_sampling.verify_interpolated && ros::ok())
+      {
+        verifyInterpolatedRecords();
+      }
+    }
+    else
+    {
+      std::vector<std::vector<std::size_t>> fronts;
+      if(sp_.neighbor_seeding)
+      {
+        fronts = getSeedingFronts(*cloud_, kd_tree, indices, sp_.optimization.radius, pool_->size());
+      }
+      else
+      {
+        fronts.push_back(indices);
+      }
+
+      // The points of a front are solved concurrently; each front is only started once the previous one is complete
+      for(const std::vector<std::size_t>& front : fronts)
+      {
+        solve(front, {});
+      }
+    }
+  }
+
+  if(db_->size() < cloud_->points.size())
+  {
+    db_->save(results_dir_ + CHECKPOINT_DB_NAME);
+    return false;
+  }
+
+  // Save the results of the reach study to a database that we can query later
+  db_->save(results_dir_ + SAVED_DB_NAME);
+  ReachDatabase::remove(results_dir_ + CHECKPOINT_DB_NAME);
+
+  // An optimization checkpoint left over from an earlier study does not apply to the new results
+  ReachDatabase::remove(results_dir_ + OPT_CHECKPOINT_DB_NAME);
+
+  return true;
+}
+
+void ReachStudy::solveBatch(const std::vector<std::size_t>& indices,
+                            const std::vector<std::vector<double>>& seeds,
+                            const reach::plugins::IKSolverBasePtr& ik_solver)
+{
+  const std::vector<std::string> joint_names = ik_solver->getJointNames();
+
+  // Get poses from point cloud array and the seed positions
+  reach::plugins::IsometryVector targets;
+  targets.reserve(indices.size());
+  std::vector<std::vector<double>> seed_positions;
+  seed_positions.reserve(indices.size());
+  for(std::size_t k = 0; k < indices.size(); ++k)
+  {
+    targets.push_back(createTargetFrame(cloud_->points[indices[k]]));
+    seed_positions.push_back(seeds[k].empty() ? std::vector<double>(joint_names.size(), 0.0) : seeds[k]);
+  }
+
+  // Solve IK
+  std::vector<std::vector<double>> solutions;
+  std::vector<boost::optional<double>> scores;
+  ik_solver->solveIKBatch(targets, seed_positions, solutions, scores);
+
+  for(std::size_t k = 0; k < indices.size(); ++k)
+  {
     // Create objects to save in the reach record
     geometry_msgs::Pose tgt_pose;
-    tf::poseEigenToMsg(tgt_frame, tgt_pose);
+    tf::poseEigenToMsg(targets[k], tgt_pose);
+
+    sensor_msgs::JointState seed_state;
+    seed_state.name = joint_names;
+    seed_state.position = std::move(seed_positions[k]);
 
     sensor_msgs::JointState goal_state (seed_state);
 
-    if(score)
+    if(scores[k])
     {
-      goal_state.position = solution;
-      auto msg = makeRecord(std::to_string(i), true, tgt_pose, seed_state, goal_state, *score);
+      goal_state.position = std::move(solutions[k]);
+      auto msg = makeRecord(std::to_string(indices[k]), true, tgt_pose, seed_state, goal_state, *scores[k]);
       db_->put(msg);
     }
     else
     {
-      auto msg = makeRecord(std::to_string(i), false, tgt_pose, seed_state, goal_state, 0.0);
+      auto msg = makeRecord(std::to_string(indices[k]), false, tgt_pose, seed_state, goal_state, 0.0);
       db_->put(msg);
     }
-
-    // Print function progress
-    current_counter++;
-    utils::integerProgressPrinter(current_counter, previous_pct, cloud_size);
   }
+}
 
-  // Save the results of the reach study to a database that we can query later
-  db_->calculateResults();
-  db_->save(results_dir_ + SAVED_DB_NAME);
+void ReachStudy::verifyInterpolatedRecords()
+{
+  const std::vector<std::string> ids = db_->getInterpolatedIDs();
+  ROS_INFO("Verifying %lu interpolated points", ids.size());
+
+  std::atomic<int> current_counter, previous_pct;
+  current_counter = previous_pct = 0;
+
+  const std::size_t batch_size = getBatchSize(ids.size(), pool_->size());
+  const std::size_t n_batches = (ids.size() + batch_size - 1) / batch_size;
+
+  // Solve each interpolated point, seeded from the joint state that was estimated for it
+  pool_->parallelFor(n_batches, [&](const std::size_t b, const std::size_t worker)
+  {
+    if(!ros::ok())
+    {
+      return;
+    }
+
+    std::vector<std::size_t> batch;
+    std::vector<std::vector<double>> batch_seeds;
+    for(std::size_t j = b * batch_size; j < std::min((b + 1) * batch_size, ids.size()); ++j)
+    {
+      const reach_msgs::ReachRecord rec = *db_->get(ids[j]);
+      batch.push_back(std::stoul(ids[j]));
+      batch_seeds.push_back(rec.reached ? rec.goal_state.position : std::vector<double>());
+    }
+
+    solveBatch(batch, batch_seeds, solver_pool_[worker]);
+
+    // Print function progress
+    current_counter += static_cast<int>(batch.size());
+    utils::integerProgressPrinter(current_counter, previous_pct, static_cast<int>(ids.size()));
+  });
 }
 
 void ReachStudy::optimizeReachStudyResults()
@@ -305,53 +1227,130 @@ void ReachStudy::optimizeReachStudyResults()
   ROS_INFO("----------------------");
   ROS_INFO("Beginning optimization");
 
-  // Create sequential vector to be randomized
-  std::vector<std::size_t> rand_vec (db_->size());
-  std::iota(rand_vec.begin(), rand_vec.end(), 0);
+  // Log every change to the records while optimizing, so that an interrupted optimization can resume from where it stopped
+  const std::string checkpoint = results_dir_ + OPT_CHECKPOINT_DB_NAME;
+  db_->startLog(checkpoint);
+
+  // Partition the points into cells and phases that can be optimized concurrently
+  std::vector<std::vector<std::vector<std::size_t>>> phases = partitionIntoPhases(*db_, sp_.optimization.radius);
+
+  // Worklist of points to optimize from, and the expected score gain of doing so. The first pass visits every point; later passes only
+  // revisit the points whose neighborhoods contain a record that changed in the previous pass. Both are indexed by record ID, which
+  // may be sparse (e.g. after a merged load or an incremental re-study)
+  std::vector<char> dirty (db_->getIDLimit(), 0);
+  std::vector<double> priority (db_->getIDLimit(), 0.0);
+  if(revisit_.empty())
+  {
+    for(std::size_t p = 0; p < db_->size(); ++p)
+    {
+      dirty[db_->getIDAt(p)] = 1;
+    }
+  }
+  for(const std::size_t id : revisit_)
+  {
+    dirty[id] = 1;
+    for(const std::size_t n : neighbor_graph_->getNeighbors(id))
+    {
+      dirty[n] = 1;
+    }
+  }
+  std::size_t n_dirty = static_cast<std::size_t>(std::count(dirty.begin(), dirty.end(), 1));
+
+  // Records updated by each worker during a pass
+  std::vector<std::vector<std::pair<std::string, double>>> updates (pool_->size());
 
   // Iterate
   std::atomic<int> current_counter, previous_pct;
-  const int cloud_size = static_cast<int>(cloud_->size());
   int n_opt = 0;
   float previous_score = 0.0;
   float pct_improve = 1.0;
 
-  while(pct_improve > sp_.optimization.step_improvement_threshold && n_opt < sp_.optimization.max_steps)
+  while(n_dirty > 0 && pct_improve > sp_.optimization.step_improvement_threshold && n_opt < sp_.optimization.max_steps)
   {
-    ROS_INFO("Entering optimization loop %d", n_opt);
+    ROS_INFO("Entering optimization loop %d (%lu points to revisit)", n_opt, n_dirty);
     previous_score = db_->getStudyResults().norm_total_pose_score;
     current_counter = 0;
     previous_pct = 0;
 
-    // Randomize
-    std::random_shuffle(rand_vec.begin(), rand_vec.end());
-
-    #pragma parallel for
-    for(std::size_t i = 0; i < rand_vec.size(); ++i)
+    // The cells of a phase are processed concurrently, and the dirty points within a cell are processed serially in order of
+    // decreasing expected gain (ties in random order)
+    for(const std::vector<std::vector<std::size_t>>& cells : phases)
     {
-      auto it = db_->begin();
-      std::advance(it, rand_vec[i]);
-      reach_msgs::ReachRecord msg = it->second;
-      if(msg.reached)
+      std::vector<std::vector<std::size_t>> worklists (cells.size());
+      for(std::size_t i = 0; i < cells.size(); ++i)
       {
-        NeighborReachResult result = reachNeighborsDirect(db_, msg, ik_solver_, sp_.optimization.radius); //, search_tree_);
+        for(const std::size_t id : cells[i])
+        {
+          if(dirty[id])
+          {
+            worklists[i].push_back(id);
+          }
+        }
+
+        std::random_shuffle(worklists[i].begin(), worklists[i].end());
+        std::stable_sort(worklists[i].begin(), worklists[i].end(), [&priority](const std::size_t a, const std::size_t b) {
+          return priority[a] > priority[b];
+        });
       }
 
-      // Print function progress
-      current_counter++;
-      utils::integerProgressPrinter(current_counter, previous_pct, cloud_size);
+      pool_->parallelFor(worklists.size(), [&](const std::size_t i, const std::size_t worker)
+      {
+        for(const std::size_t id : worklists[i])
+        {
+          if(db_->isReached(id))
+          {
+            const reach_msgs::ReachRecord msg = *db_->get(id);
+            NeighborReachResult result = reachNeighborsDirect(db_, msg, solver_pool_[worker], sp_.optimization.radius, spatial_index_,
+                                                              neighbor_graph_, transition_cache_);
+            updates[worker].insert(updates[worker].end(), result.updated_pts.begin(), result.updated_pts.end());
+          }
+
+          // Print function progress
+          current_counter++;
+          utils::integerProgressPrinter(current_counter, previous_pct, static_cast<int>(n_dirty));
+        }
+      });
+    }
+
+    // Build the worklist for the next pass from the records that changed in this one: a changed record can seed better solutions for
+    // its neighbors, and its neighbors may now reach it with a better solution
+    std::fill(dirty.begin(), dirty.end(), 0);
+    std::fill(priority.begin(), priority.end(), 0.0);
+    for(std::vector<std::pair<std::string, double>>& worker_updates : updates)
+    {
+      for(const std::pair<std::string, double>& update : worker_updates)
+      {
+        const std::size_t id = std::stoul(update.first);
+        dirty[id] = 1;
+        priority[id] = std::max(priority[id], update.second);
+        for(const std::size_t n : neighbor_graph_->getNeighbors(id))
+        {
+          dirty[n] = 1;
+          priority[n] = std::max(priority[n], update.second);
+        }
+      }
+      worker_updates.clear();
     }
+    n_dirty = static_cast<std::size_t>(std::count(dirty.begin(), dirty.end(), 1));
 
-    // Recalculate optimized reach study results
-    db_->calculateResults();
+    // The results are updated as records are written
     db_->printResults();
     pct_improve = std::abs((db_->getStudyResults().norm_total_pose_score - previous_score)/previous_score);
     ++ n_opt;
+
+    // Fold the changes of this pass into the checkpoint, which restarts the log
+    db_->save(checkpoint);
   }
 
   // Save the optimized reach database
-  db_->calculateResults();
   db_->save(results_dir_ + OPT_SAVED_DB_NAME);
+  db_->stopLog();
+  ReachDatabase::remove(checkpoint);
+
+  if(transition_cache_)
+  {
+    ROS_INFO_STREAM("Cached transitions: " << transition_cache_->getHits() << " hits, " << transition_cache_->getMisses() << " misses");
+  }
 
   ROS_INFO("----------------------");
   ROS_INFO("Optimization concluded");
@@ -362,39 +1361,72 @@ void ReachStudy::getAverageNeighborsCount()
   ROS_INFO("--------------------------------------------");
   ROS_INFO("Beginning average neighbor count calculation");
 
-  std::atomic<int> current_counter, previous_pct, neighbor_count;
-  current_counter = previous_pct = neighbor_count = 0;
-  std::atomic<double> total_joint_distance;
-  const int total = db_->size();
+  spatial_index_->update(*db_);
+  updateNeighborGraph();
 
-  // Iterate
-  #pragma parallel for
-  for(auto it = db_->begin(); it != db_->end(); ++it)
+  float avg_neighbor_count = 0.0f;
+  float avg_joint_distance = 0.0f;
+  if(sp_.neighbor_analysis == "components")
   {
-    reach_msgs::ReachRecord msg = it->second;
-    if(msg.reached)
+    // Solve the IK of each edge of the neighbor graph once and group the reached records into joint-space-continuous components. Its
+    // metrics are defined differently from those of the flood fill (see ComponentAnalysis)
+    ComponentAnalysis analysis;
+    analysis.run(*pool_, solver_pool_, *db_, *neighbor_graph_, transition_cache_);
+
+    const std::vector<std::size_t>& sizes = analysis.getComponentSizes();
+    ROS_INFO_STREAM("Number of solved neighbor transitions: " << analysis.getTransitionCount());
+    ROS_INFO_STREAM("Number of connected components: " << sizes.size());
+    for(std::size_t i = 0; i < std::min<std::size_t>(sizes.size(), 5); ++i)
     {
-      NeighborReachResult result;
-      reachNeighborsRecursive(db_, msg, ik_solver_, sp_.optimization.radius, result); //, search_tree_);
-
-      neighbor_count += static_cast<int>(result.reached_pts.size() - 1);
-      total_joint_distance = total_joint_distance + result.joint_distance;
+      ROS_INFO_STREAM("Component " << i + 1 << " size: " << sizes[i]);
     }
 
-    // Print function progress
-    ++ current_counter;
-    utils::integerProgressPrinter(current_counter, previous_pct, total);
+    avg_neighbor_count = analysis.getAverageConnectedCount();
+    avg_joint_distance = analysis.getAverageEdgeJointDistance();
+
+    ROS_INFO_STREAM("Average number of connected records: " << avg_neighbor_count);
+    ROS_INFO_STREAM("Average joint distance per transition: " << avg_joint_distance);
   }
+  else
+  {
+    // Flood fill the region reachable from each reached record, expanding the frontiers of each fill in parallel
+    ReachQuery query;
+    query.reached = true;
+    const std::vector<RecordView> reached = db_->query(query);
+
+    std::atomic<int> current_counter, previous_pct;
+    current_counter = previous_pct = 0;
+    std::size_t neighbor_count = 0;
+    double total_joint_distance = 0.0;
+    const int total = static_cast<int>(reached.size());
+
+    for(const RecordView& view : reached)
+    {
+      boost::optional<reach_msgs::ReachRecord> msg = db_->get(view.id);
+      if(msg)
+      {
+        const NeighborReachResult result = reachNeighborsRecursive(db_, *msg, *pool_, solver_pool_, sp_.optimization.radius,
+                                                                   spatial_index_, neighbor_graph_, transition_cache_);
+        neighbor_count += result.reached_pts.size() - 1;
+        total_joint_distance += result.joint_distance;
+      }
 
-  float avg_neighbor_count = static_cast<float>(neighbor_count.load()) / static_cast<float>(db_->size());
-  float avg_joint_distance = static_cast<float>(total_joint_distance.load()) / static_cast<float>(neighbor_count.load());
+      // Print function progress
+      ++ current_counter;
+      utils::integerProgressPrinter(current_counter, previous_pct, total);
+    }
 
-  ROS_INFO_STREAM("Average number of neighbors reached: " << avg_neighbor_count);
-  ROS_INFO_STREAM("Average joint distance: " << avg_joint_distance);
+    avg_neighbor_count = static_cast<float>(neighbor_count) / static_cast<float>(db_->size());
+    avg_joint_distance = static_cast<float>(total_joint_distance) / static_cast<float>(neighbor_count);
+
+    ROS_INFO_STREAM("Average number of neighbors reached: " << avg_neighbor_count);
+    ROS_INFO_STREAM("Average joint distance: " << avg_joint_distance);
+  }
   ROS_INFO("------------------------------------------------");
 
   db_->setAverageNeighborsCount(avg_neighbor_count);
   db_->setAverageJointDistance(avg_joint_distance);
+  db_->setNeighborAnalysis(sp_.neighbor_analysis);
   db_->save(results_dir_ + OPT_SAVED_DB_NAME);
 }
 
@@ -415,6 +1447,7 @@ bool ReachStudy::compareDatabases()
 
   // Load databases to be compared
   std::map<std::string, reach_msgs::ReachDatabase> data;
+  std::map<std::string, std::string> methods;
   for(size_t i = 0; i < db_filenames.size(); ++i)
   {
     ReachDatabase db;
@@ -424,6 +1457,26 @@ bool ReachStudy::compareDatabases()
       continue;
     }
     data.emplace(sp_.compare_dbs[i], db.toReachDatabaseMsg());
+
+    const std::string method = db.getStudyResults().neighbor_analysis;
+    if(!method.empty())
+    {
+      methods.emplace(sp_.compare_dbs[i], method);
+    }
+  }
+
+  // The neighbor metrics of databases analyzed with different methods are not comparable
+  for(const auto& pair : methods)
+  {
+    if(pair.second != methods.begin()->second)
+    {
+      ROS_WARN("The neighbor metrics of the compared databases were computed by different methods:");
+      for(const auto& p : methods)
+      {
+        ROS_WARN_STREAM("  " << p.first << ": " << p.second);
+      }
+      break;
+    }
   }
 
   if(data.size() < 2)
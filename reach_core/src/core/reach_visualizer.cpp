@@ -27,11 +27,13 @@ ReachVisualizer::ReachVisualizer(ReachDatabasePtr db,
                                  reach::plugins::IKSolverBasePtr solver,
                                  reach::plugins::DisplayBasePtr display,
                                  const double neighbor_radius,
-                                 SearchTreePtr search_tree)
+                                 SpatialIndexPtr spatial_index,
+                                 TransitionCachePtr transition_cache)
   : db_(db)
   , solver_(solver)
   , display_(display)
-  , search_tree_(search_tree)
+  , spatial_index_(spatial_index)
+  , transition_cache_(transition_cache)
   , neighbor_radius_(neighbor_radius)
 {
   // Create menu functions for the display and tie them to members of this class
@@ -51,14 +53,23 @@ ReachVisualizer::ReachVisualizer(ReachDatabasePtr db,
   display_->createMenuFunction("Show Reach to Neighbors (Recursive)", neighbors_recursive_cb);
 
   // Add interactive markers to the display from the reach database
-  display_->addInteractiveMarkerData(db_->toReachDatabaseMsg());
+  update();
 }
 
 void ReachVisualizer::update()
 {
+  if(spatial_index_)
+  {
+    spatial_index_->update(*db_);
+  }
   display_->addInteractiveMarkerData(db_->toReachDatabaseMsg());
 }
 
+void ReachVisualizer::setNeighborGraph(NeighborGraphPtr neighbor_graph)
+{
+  std::atomic_store(&neighbor_graph_, neighbor_graph);
+}
+
 void ReachVisualizer::reSolveIKCB(const visualization_msgs::InteractiveMarkerFeedbackConstPtr &fb)
 {
   boost::optional<reach_msgs::ReachRecord> lookup = db_->get(fb->marker_name);
@@ -137,7 +148,8 @@ void ReachVisualizer::reachNeighborsDirectCB(const visualization_msgs::Interacti
   auto lookup = db_->get(fb->marker_name);
   if(lookup)
   {
-    NeighborReachResult result = reachNeighborsDirect(db_, *lookup, solver_, neighbor_radius_, search_tree_);
+    NeighborReachResult result = reachNeighborsDirect(db_, *lookup, solver_, neighbor_radius_, spatial_index_,
+                                                      std::atomic_load(&neighbor_graph_), transition_cache_);
 
     display_->updateRobotPose(jointStateMsgToMap(lookup->goal_state));
     display_->publishMarkerArray(result.reached_pts);
@@ -156,8 +168,8 @@ void ReachVisualizer::reachNeighborsRecursiveCB(const visualization_msgs::Intera
   auto lookup = db_->get(fb->marker_name);
   if(lookup)
   {
-    NeighborReachResult result;
-    reachNeighborsRecursive(db_, *lookup, solver_, neighbor_radius_, result, search_tree_);
+    NeighborReachResult result = reachNeighborsRecursive(db_, *lookup, solver_, neighbor_radius_, spatial_index_,
+                                                         std::atomic_load(&neighbor_graph_), transition_cache_);
 
     display_->updateRobotPose(jointStateMsgToMap(lookup->goal_state));
     display_->publishMarkerArray(result.reached_pts);
@@ -0,0 +1,242 @@
+/*
+ * Copyright 2019 Southwest Research Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <reach_core/spatial_index.h>
+#include <flann/flann.h>
+#include <flann/algorithms/kdtree_single_index.h>
+#include <array>
+#include <cmath>
+#include <unordered_map>
+
+namespace
+{
+
+class KdTreeSnapshot : public reach::core::SpatialIndex::Snapshot
+{
+public:
+
+  KdTreeSnapshot(const std::vector<std::size_t>& ids,
+                 const std::vector<double>& points)
+    : ids_(ids)
+    , points_(points)
+    , tree_(flann::KDTreeSingleIndexParams(10, false))
+  {
+    if(!ids_.empty())
+    {
+      tree_.buildIndex(flann::Matrix<double>(points_.data(), ids_.size(), 3));
+    }
+  }
+
+  void radiusSearch(const double* pt,
+                    const double radius,
+                    std::vector<std::size_t>& ids) const override
+  {
+    if(ids_.empty())
+    {
+      return;
+    }
+
+    double query_pt[3] = {pt[0], pt[1], pt[2]};
+    flann::Matrix<double> query (query_pt, 1, 3);
+
+    // The L2 distance functor operates on squared distances
+    std::vector<std::vector<int>> indices;
+    std::vector<std::vector<double>> distances;
+    tree_.radiusSearch(query, indices, distances, static_cast<float>(radius * radius), flann::SearchParams());
+
+    for(const std::vector<int>& row : indices)
+    {
+      for(const int i : row)
+      {
+        ids.push_back(ids_[static_cast<std::size_t>(i)]);
+      }
+    }
+  }
+
+private:
+
+  const std::vector<std::size_t> ids_;
+  /** @brief Data set of the tree, which the tree does not copy */
+  std::vector<double> points_;
+  mutable flann::KDTreeSingleIndex<flann::L2_3D<double>> tree_;
+};
+
+typedef std::array<long, 3> CellKey;
+
+struct CellKeyHash
+{
+  std::size_t operator()(const CellKey& key) const
+  {
+    return static_cast<std::size_t>(key[0] * 73856093L ^ key[1] * 19349663L ^ key[2] * 83492791L);
+  }
+};
+
+class GridSnapshot : public reach::core::SpatialIndex::Snapshot
+{
+public:
+
+  GridSnapshot(const double cell_size,
+               const std::vector<std::size_t>& ids,
+               const std::vector<double>& points)
+    : cell_size_(cell_size)
+  {
+    // Group the points by cell, and store the points of each cell contiguously
+    std::unordered_map<CellKey, std::vector<std::size_t>, CellKeyHash> members;
+    for(std::size_t i = 0; i < ids.size(); ++i)
+    {
+      members[getKey(&points[3 * i])].push_back(i);
+    }
+
+    ids_.reserve(ids.size());
+    points_.reserve(points.size());
+    cells_.reserve(members.size());
+    for(const auto& pair : members)
+    {
+      cells_.emplace(pair.first, std::make_pair(ids_.size(), ids_.size() + pair.second.size()));
+      for(const std::size_t i : pair.second)
+      {
+        ids_.push_back(ids[i]);
+        points_.insert(points_.end(), points.begin() + 3 * i, points.begin() + 3 * (i + 1));
+      }
+    }
+  }
+
+  void radiusSearch(const double* pt,
+                    const double radius,
+                    std::vector<std::size_t>& ids) const override
+  {
+    const CellKey center = getKey(pt);
+    const long extent = static_cast<long>(std::ceil(radius / cell_size_));
+    const double radius_sq = radius * radius;
+
+    CellKey key;
+    for(key[0] = center[0] - extent; key[0] <= center[0] + extent; ++key[0])
+    {
+      for(key[1] = center[1] - extent; key[1] <= center[1] + extent; ++key[1])
+      {
+        for(key[2] = center[2] - extent; key[2] <= center[2] + extent; ++key[2])
+        {
+          const auto cell = cells_.find(key);
+          if(cell == cells_.end())
+          {
+            continue;
+          }
+
+          for(std::size_t i = cell->second.first; i < cell->second.second; ++i)
+          {
+            const double dx = points_[3 * i] - pt[0];
+            const double dy = points_[3 * i + 1] - pt[1];
+            const double dz = points_[3 * i + 2] - pt[2];
+            if(dx * dx + dy * dy + dz * dz < radius_sq)
+            {
+              ids.push_back(ids_[i]);
+            }
+          }
+        }
+      }
+    }
+  }
+
+private:
+
+  CellKey getKey(const double* pt) const
+  {
+    return {{static_cast<long>(std::floor(pt[0] / cell_size_)),
+             static_cast<long>(std::floor(pt[1] / cell_size_)),
+             static_cast<long>(std::floor(pt[2] / cell_size_))}};
+  }
+
+  double cell_size_;
+  std::vector<std::size_t> ids_;
+  std::vector<double> points_;
+  /** @brief Range of the points of each occupied cell */
+  std::unordered_map<CellKey, std::pair<std::size_t, std::size_t>, CellKeyHash> cells_;
+};
+
+} // namespace anonymous
+
+namespace reach
+{
+namespace core
+{
+
+void SpatialIndex::update(const ReachDatabase& db)
+{
+  std::lock_guard<std::mutex> lock {update_mutex_};
+
+  // Records are appended to the positional index of the database, so the records at the positions after the last indexed one are new
+  const std::size_t n = db.size();
+  if(n == ids_.size() && snapshot_)
+  {
+    return;
+  }
+
+  for(std::size_t p = ids_.size(); p < n; ++p)
+  {
+    const std::size_t id = db.getIDAt(p);
+    const geometry_msgs::Point pt = db.getGoalPosition(id);
+    ids_.push_back(id);
+    points_.insert(points_.end(), {pt.x, pt.y, pt.z});
+  }
+
+  std::atomic_store(&snapshot_, build(ids_, points_));
+}
+
+std::vector<std::size_t> SpatialIndex::radiusSearch(const geometry_msgs::Point& pt,
+                                                    const double radius) const
+{
+  std::vector<std::size_t> ids;
+  const SnapshotPtr snapshot = std::atomic_load(&snapshot_);
+  if(snapshot)
+  {
+    const double query[3] = {pt.x, pt.y, pt.z};
+    snapshot->radiusSearch(query, radius, ids);
+  }
+  return ids;
+}
+
+SpatialIndex::SnapshotPtr KdTreeIndex::build(const std::vector<std::size_t>& ids,
+                                             const std::vector<double>& points) const
+{
+  return std::make_shared<const KdTreeSnapshot>(ids, points);
+}
+
+GridIndex::GridIndex(const double cell_size)
+  : cell_size_(cell_size)
+{
+}
+
+SpatialIndex::SnapshotPtr GridIndex::build(const std::vector<std::size_t>& ids,
+                                           const std::vector<double>& points) const
+{
+  return std::make_shared<const GridSnapshot>(cell_size_, ids, points);
+}
+
+SpatialIndexPtr makeSpatialIndex(const std::string& type,
+                                 const double radius)
+{
+  if(type == "kdtree")
+  {
+    return std::make_shared<KdTreeIndex>();
+  }
+  else if(type == "grid" && radius > 0.0)
+  {
+    return std::make_shared<GridIndex>(radius);
+  }
+  return nullptr;
+}
+
+} // namespace core
+} // namespace reach
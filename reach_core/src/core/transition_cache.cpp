@@ -0,0 +1,164 @@
+/*
+ * Copyright 2019 Southwest Research Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <reach_core/transition_cache.h>
+#include <algorithm>
+
+namespace
+{
+
+/** @brief Minimum number of entries per shard, so that small caches are not split into shards that evict on every collision */
+const static std::size_t MIN_SHARD_CAPACITY = 64;
+
+bool equal(const geometry_msgs::Pose& a,
+           const geometry_msgs::Pose& b)
+{
+  return a.position.x == b.position.x && a.position.y == b.position.y && a.position.z == b.position.z &&
+         a.orientation.x == b.orientation.x && a.orientation.y == b.orientation.y && a.orientation.z == b.orientation.z &&
+         a.orientation.w == b.orientation.w;
+}
+
+} // namespace anonymous
+
+namespace reach
+{
+namespace core
+{
+
+std::size_t TransitionCache::KeyHash::operator()(const Key& key) const
+{
+  std::uint64_t h = static_cast<std::uint64_t>(key.source) * 0x9E3779B97F4A7C15ULL ^ static_cast<std::uint64_t>(key.target);
+  h ^= h >> 31;
+  h *= 0xBF58476D1CE4E5B9ULL;
+  h ^= h >> 29;
+  return static_cast<std::size_t>(h);
+}
+
+TransitionCache::TransitionCache(const std::size_t capacity,
+                                 const std::size_t n_shards)
+{
+  const std::size_t n = std::max<std::size_t>(1, std::min(n_shards, capacity / MIN_SHARD_CAPACITY));
+  shards_.reserve(n);
+  for(std::size_t i = 0; i < n; ++i)
+  {
+    shards_.emplace_back(new Shard());
+  }
+  shard_capacity_ = capacity / n;
+}
+
+TransitionCache::Shard& TransitionCache::getShard(const Key& key)
+{
+  // Use the high bits of the hash, since the low bits select the bucket within the shard
+  return *shards_[(static_cast<std::uint64_t>(KeyHash()(key)) >> 32) % shards_.size()];
+}
+
+bool TransitionCache::find(const std::size_t source,
+                           const std::uint64_t version,
+                           const std::size_t target,
+                           const std::vector<double>& seed,
+                           const geometry_msgs::Pose& target_pose,
+                           Transition& transition)
+{
+  const Key key {source, target};
+  Shard& shard = getShard(key);
+  std::lock_guard<std::mutex> lock {shard.mutex};
+
+  auto it = shard.index.find(key);
+  if(it != shard.index.end())
+  {
+    const Entry& entry = *it->second;
+    if(entry.version != version)
+    {
+      // The solution of the source record changed since the entry was stored
+      shard.entries.erase(it->second);
+      shard.index.erase(it);
+    }
+    else if(entry.seed == seed && equal(entry.target_pose, target_pose))
+    {
+      shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+      transition = entry.transition;
+      ++hits_;
+      return true;
+    }
+  }
+
+  ++misses_;
+  return false;
+}
+
+void TransitionCache::insert(const std::size_t source,
+                             const std::uint64_t version,
+                             const std::size_t target,
+                             const std::vector<double>& seed,
+                             const geometry_msgs::Pose& target_pose,
+                             const Transition& transition)
+{
+  if(shard_capacity_ == 0)
+  {
+    return;
+  }
+
+  const Key key {source, target};
+  Shard& shard = getShard(key);
+  std::lock_guard<std::mutex> lock {shard.mutex};
+
+  auto it = shard.index.find(key);
+  if(it != shard.index.end())
+  {
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+  }
+  else
+  {
+    shard.entries.emplace_front();
+    shard.index.emplace(key, shard.entries.begin());
+
+    if(shard.entries.size() > shard_capacity_)
+    {
+      shard.index.erase(shard.entries.back().key);
+      shard.entries.pop_back();
+    }
+  }
+
+  Entry& entry = shard.entries.front();
+  entry.key = key;
+  entry.version = version;
+  entry.seed = seed;
+  entry.target_pose = target_pose;
+  entry.transition = transition;
+}
+
+void TransitionCache::clear()
+{
+  for(const std::unique_ptr<Shard>& shard : shards_)
+  {
+    std::lock_guard<std::mutex> lock {shard->mutex};
+    shard->entries.clear();
+    shard->index.clear();
+  }
+}
+
+std::size_t TransitionCache::size() const
+{
+  std::size_t n = 0;
+  for(const std::unique_ptr<Shard>& shard : shards_)
+  {
+    std::lock_guard<std::mutex> lock {shard->mutex};
+    n += shard->entries.size();
+  }
+  return n;
+}
+
+} // namespace core
+} // namespace reach
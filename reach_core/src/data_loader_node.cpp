@@ -14,37 +14,98 @@
  * limitations under the License.
  */
 #include "reach_core/reach_database.h"
+#include "reach_core/utils/task_pool.h"
 #include <ros/ros.h>
 #include <ros/package.h>
 #include <boost/filesystem.hpp>
 #include <boost/format.hpp>
+#include <algorithm>
+#include <tuple>
 
 const static std::string RESULTS_FOLDER_NAME = "results";
 const static std::string OPT_DB_NAME = "optimized_reach.db";
 
+struct DatabaseEntry
+{
+  boost::filesystem::path config;
+  boost::filesystem::path path;
+  reach::core::StudyResults results;
+};
+
+bool operator<(const DatabaseEntry& a, const DatabaseEntry& b)
+{
+  return std::tie(a.config, a.path) < std::tie(b.config, b.path);
+}
+
+/**
+ * @brief find_databases recursively searches the input directory for optimized reach databases and reads their results
+ */
+void find_databases(const boost::filesystem::path& dir,
+                    const bool recursive,
+                    const std::string& ext,
+                    std::vector<DatabaseEntry>& ret)
+{
+  auto check = [&](const boost::filesystem::path& p)
+  {
+    // Capture only the optimized reach databases, and only read their summary results rather than all of their records
+    DatabaseEntry entry;
+    if(boost::filesystem::is_regular_file(p) && p.extension() == ext && p.filename() == OPT_DB_NAME &&
+       reach::core::ReachDatabase::loadResults(p.string(), entry.results))
+    {
+      entry.config = p.parent_path().filename();
+      entry.path = p;
+      ret.push_back(entry);
+    }
+  };
+
+  if(recursive)
+  {
+    boost::filesystem::recursive_directory_iterator it(dir);
+    boost::filesystem::recursive_directory_iterator endit;
+    for(; it != endit; ++it)
+    {
+      check(it->path());
+    }
+  }
+  else
+  {
+    boost::filesystem::directory_iterator it(dir);
+    boost::filesystem::directory_iterator endit;
+    for(; it != endit; ++it)
+    {
+      check(it->path());
+    }
+  }
+}
+
 bool get_all(const boost::filesystem::path& root,
              const std::string& ext,
-             std::vector<std::pair<boost::filesystem::path, boost::filesystem::path>>& ret)
+             std::vector<DatabaseEntry>& ret)
 {
   if(!boost::filesystem::exists(root) || !boost::filesystem::is_directory(root)) return false;
 
-  boost::filesystem::recursive_directory_iterator it(root);
-  boost::filesystem::recursive_directory_iterator endit;
-
-  while(it != endit)
+  // Search each sub-directory of the root (typically one per configuration) in parallel
+  std::vector<boost::filesystem::path> dirs;
+  for(boost::filesystem::directory_iterator it(root), endit; it != endit; ++it)
   {
-    if(boost::filesystem::is_regular_file(*it) && it->path().extension() == ext)
+    if(boost::filesystem::is_directory(it->path()))
     {
-      // Capture only the optimized reach databases
-      if(it->path().filename() == OPT_DB_NAME)
-      {
-        std::pair<boost::filesystem::path, boost::filesystem::path> tmp;
-        tmp.first = it->path().parent_path().filename();
-        tmp.second = it->path();
-        ret.push_back(tmp);
-      }
+      dirs.push_back(it->path());
     }
-    ++it;
+  }
+
+  std::vector<std::vector<DatabaseEntry>> found (dirs.size() + 1);
+  find_databases(root, false, ext, found.back());
+
+  reach::utils::TaskPool pool;
+  pool.parallelFor(dirs.size(), [&](const std::size_t i, const std::size_t)
+  {
+    find_databases(dirs[i], true, ext, found[i]);
+  });
+
+  for(const std::vector<DatabaseEntry>& entries : found)
+  {
+    ret.insert(ret.end(), entries.begin(), entries.end());
   }
 
   std::sort(ret.begin(), ret.end());
@@ -68,36 +129,33 @@ int main(int argc, char **argv)
   }
 
   boost::filesystem::path root (root_path);
-  std::vector<std::pair<boost::filesystem::path, boost::filesystem::path>> files;
+  std::vector<DatabaseEntry> files;
   if(!get_all(root, ".db", files))
   {
     std::cout << "Specified directory does not exist";
     return 0;
   }
 
-  std::cout << boost::format("%-30s %=25s %=25s %=25s %=25s\n")
+  // The neighbor metrics are only comparable between studies that computed them with the same neighbor analysis method
+  std::cout << boost::format("%-30s %=25s %=25s %=20s %=25s %=25s\n")
                % "Configuration Name"
                % "Reach Percentage"
                % "Normalized Total Pose Score"
+               % "Neighbor Analysis"
                % "Average Reachable Neighbors"
                % "Average Joint Distance";
 
   for(size_t i = 0; i < files.size(); ++i)
   {
-    const std::string config = files[i].first.string();
-    const std::string path = files[i].second.string();
-
-    reach::core::ReachDatabase db;
-    if(db.load(path))
-    {
-      reach::core::StudyResults res = db.getStudyResults();
-      std::cout << boost::format("%-30s %=25.3f %=25.6f %=25.3f %=25.3f\n")
-                   % config.c_str()
-                   % res.reach_percentage
-                   % res.norm_total_pose_score
-                   % res.avg_num_neighbors
-                   % res.avg_joint_distance;
-    }
+    const std::string config = files[i].config.string();
+    const reach::core::StudyResults& res = files[i].results;
+    std::cout << boost::format("%-30s %=25.3f %=25.6f %=20s %=25.3f %=25.3f\n")
+                 % config.c_str()
+                 % res.reach_percentage
+                 % res.norm_total_pose_score
+                 % (res.neighbor_analysis.empty() ? "-" : res.neighbor_analysis.c_str())
+                 % res.avg_num_neighbors
+                 % res.avg_joint_distance;
   }
 
   return 0;
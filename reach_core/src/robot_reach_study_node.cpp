@@ -49,6 +49,28 @@ bool getStudyParameters(ros::NodeHandle& nh,
      return false;
   }
 
+  // Optional parameters
+  nh.param<std::string>("optimization/spatial_index", sp.optimization.spatial_index, "kdtree");
+  nh.param<int>("optimization/transition_cache_size", sp.optimization.transition_cache_size, 100000);
+  nh.param<std::string>("neighbor_analysis", sp.neighbor_analysis, "flood_fill");
+  nh.param<int>("max_threads", sp.max_threads, 0);
+  nh.param<double>("checkpoint_interval", sp.checkpoint_interval, 60.0);
+  nh.param<bool>("neighbor_seeding", sp.neighbor_seeding, false);
+  nh.param<bool>("adaptive_sampling/enable", sp.adaptive_sampling.enable, false);
+  nh.param<float>("adaptive_sampling/voxel_size", sp.adaptive_sampling.voxel_size, 0.0f);
+  nh.param<float>("adaptive_sampling/score_deviation_threshold", sp.adaptive_sampling.score_deviation_threshold, 0.1f);
+  nh.param<bool>("adaptive_sampling/verify_interpolated", sp.adaptive_sampling.verify_interpolated, false);
+  nh.param<bool>("incremental/enable", sp.incremental.enable, false);
+  nh.param<float>("incremental/position_tolerance", sp.incremental.position_tolerance, 0.001f);
+  nh.param<float>("incremental/angle_tolerance", sp.incremental.angle_tolerance, 0.0175f);
+  nh.param<bool>("capability_map/enable", sp.capability_map.enable, false);
+  nh.param<float>("capability_map/resolution", sp.capability_map.resolution, 0.05f);
+  nh.param<int>("capability_map/n_samples", sp.capability_map.n_samples, 1000000);
+  nh.param<bool>("compression/enable", sp.compression.enable, false);
+  nh.param<double>("compression/position_resolution", sp.compression.position_resolution, 1.0e-5);
+  nh.param<double>("compression/orientation_resolution", sp.compression.orientation_resolution, 1.0e-6);
+  nh.param<double>("compression/joint_resolution", sp.compression.joint_resolution, 1.0e-5);
+
   return true;
 }
 
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2019 Southwest Research Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "reach_core/utils/compression_utils.h"
+#include <lz4.h>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace reach
+{
+namespace utils
+{
+
+std::vector<char> compress(const char* data,
+                           const std::size_t size)
+{
+  if(size > static_cast<std::size_t>(LZ4_MAX_INPUT_SIZE))
+  {
+    throw std::runtime_error("Unable to compress " + std::to_string(size) + " bytes; the maximum is " +
+                             std::to_string(LZ4_MAX_INPUT_SIZE));
+  }
+
+  const std::uint64_t header = size;
+  std::vector<char> out (sizeof(header) + LZ4_compressBound(static_cast<int>(size)));
+  std::memcpy(out.data(), &header, sizeof(header));
+
+  const int n = LZ4_compress_default(data, out.data() + sizeof(header), static_cast<int>(size), static_cast<int>(out.size() - sizeof(header)));
+  if(n <= 0 && size > 0)
+  {
+    throw std::runtime_error("LZ4 compression failed");
+  }
+
+  out.resize(sizeof(header) + static_cast<std::size_t>(n));
+  return out;
+}
+
+bool decompress(const char* data,
+                const std::size_t size,
+                std::vector<char>& out)
+{
+  std::uint64_t header;
+  if(size < sizeof(header))
+  {
+    return false;
+  }
+  std::memcpy(&header, data, sizeof(header));
+  if(header > static_cast<std::uint64_t>(LZ4_MAX_INPUT_SIZE) || size - sizeof(header) > static_cast<std::size_t>(LZ4_MAX_INPUT_SIZE))
+  {
+    return false;
+  }
+
+  out.resize(header);
+  if(header == 0)
+  {
+    return true;
+  }
+
+  const int n = LZ4_decompress_safe(data + sizeof(header), out.data(), static_cast<int>(size - sizeof(header)), static_cast<int>(header));
+  return n >= 0 && static_cast<std::uint64_t>(n) == header;
+}
+
+void shuffleBytes(const char* in,
+                  const std::size_t n,
+                  const std::size_t element_size,
+                  char* out)
+{
+  for(std::size_t i = 0; i < n; ++i)
+  {
+    for(std::size_t b = 0; b < element_size; ++b)
+    {
+      out[b * n + i] = in[i * element_size + b];
+    }
+  }
+}
+
+void unshuffleBytes(const char* in,
+                    const std::size_t n,
+                    const std::size_t element_size,
+                    char* out)
+{
+  for(std::size_t i = 0; i < n; ++i)
+  {
+    for(std::size_t b = 0; b < element_size; ++b)
+    {
+      out[i * element_size + b] = in[b * n + i];
+    }
+  }
+}
+
+} // namespace utils
+} // namespace reach
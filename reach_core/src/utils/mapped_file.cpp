@@ -0,0 +1,67 @@
+/*
+ * Copyright 2019 Southwest Research Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "reach_core/utils/mapped_file.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace reach
+{
+namespace utils
+{
+
+std::shared_ptr<const MappedFile> MappedFile::open(const std::string& path)
+{
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if(fd < 0)
+  {
+    return nullptr;
+  }
+
+  struct stat st;
+  if(::fstat(fd, &st) != 0 || st.st_size <= 0)
+  {
+    ::close(fd);
+    return nullptr;
+  }
+
+  // The mapping keeps its own reference to the file, so the descriptor is not needed once the file is mapped
+  const std::size_t size = static_cast<std::size_t>(st.st_size);
+  void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if(data == MAP_FAILED)
+  {
+    return nullptr;
+  }
+
+  return std::shared_ptr<const MappedFile>(new MappedFile(static_cast<const char*>(data), size));
+}
+
+MappedFile::MappedFile(const char* data, const std::size_t size)
+  : data_(data)
+  , size_(size)
+{
+
+}
+
+MappedFile::~MappedFile()
+{
+  ::munmap(const_cast<char*>(data_), size_);
+}
+
+} // namespace utils
+} // namespace reach
@@ -0,0 +1,219 @@
+/*
+ * Copyright 2019 Southwest Research Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "reach_core/utils/task_pool.h"
+#include <algorithm>
+
+namespace
+{
+
+// Identifies the pool and worker index of the current thread, if it is a worker thread
+thread_local const reach::utils::TaskPool* current_pool = nullptr;
+thread_local std::size_t current_worker = 0;
+
+} // namespace anonymous
+
+namespace reach
+{
+namespace utils
+{
+
+TaskPool::TaskPool(const std::size_t n_threads)
+  : queued_(0)
+  , pending_(0)
+  , next_queue_(0)
+  , stop_(false)
+{
+  std::size_t n = n_threads;
+  if(n == 0)
+  {
+    n = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  queues_.reserve(n);
+  for(std::size_t i = 0; i < n; ++i)
+  {
+    queues_.emplace_back(new Queue());
+  }
+
+  threads_.reserve(n);
+  for(std::size_t i = 0; i < n; ++i)
+  {
+    threads_.emplace_back(&TaskPool::work, this, i);
+  }
+}
+
+TaskPool::~TaskPool()
+{
+  {
+    std::lock_guard<std::mutex> lock {sleep_mutex_};
+    stop_ = true;
+  }
+  sleep_cv_.notify_all();
+
+  for(std::thread& t : threads_)
+  {
+    t.join();
+  }
+}
+
+void TaskPool::submit(Task task)
+{
+  std::size_t id;
+  if(current_pool == this)
+  {
+    id = current_worker;
+  }
+  else
+  {
+    id = next_queue_++ % queues_.size();
+  }
+
+  ++pending_;
+  push(id, std::move(task));
+
+  {
+    std::lock_guard<std::mutex> lock {sleep_mutex_};
+  }
+  sleep_cv_.notify_one();
+}
+
+void TaskPool::wait()
+{
+  std::unique_lock<std::mutex> lock {done_mutex_};
+  done_cv_.wait(lock, [this]() { return pending_.load() == 0; });
+
+  if(exception_)
+  {
+    std::exception_ptr ex = exception_;
+    exception_ = nullptr;
+    std::rethrow_exception(ex);
+  }
+}
+
+void TaskPool::parallelFor(const std::size_t n,
+                           const std::function<void(const std::size_t i, const std::size_t worker)>& fn)
+{
+  if(n == 0)
+  {
+    return;
+  }
+
+  // Give each worker a contiguous block of indices to start with; workers that finish their block early will steal from the others
+  const std::size_t n_queues = queues_.size();
+  const std::size_t block = (n + n_queues - 1) / n_queues;
+
+  pending_ += n;
+  for(std::size_t i = 0; i < n; ++i)
+  {
+    push(i / block, [&fn, i](const std::size_t worker) { fn(i, worker); });
+  }
+
+  {
+    std::lock_guard<std::mutex> lock {sleep_mutex_};
+  }
+  sleep_cv_.notify_all();
+
+  wait();
+}
+
+void TaskPool::work(const std::size_t id)
+{
+  current_pool = this;
+  current_worker = id;
+
+  while(true)
+  {
+    Task task;
+    if(pop(id, task) || steal(id, task))
+    {
+      try
+      {
+        task(id);
+      }
+      catch(...)
+      {
+        std::lock_guard<std::mutex> lock {done_mutex_};
+        if(!exception_)
+        {
+          exception_ = std::current_exception();
+        }
+      }
+
+      finish();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock {sleep_mutex_};
+    sleep_cv_.wait(lock, [this]() { return stop_ || queued_.load() > 0; });
+    if(stop_ && queued_.load() == 0)
+    {
+      return;
+    }
+  }
+}
+
+bool TaskPool::pop(const std::size_t id, Task& task)
+{
+  Queue& q = *queues_[id];
+  std::lock_guard<std::mutex> lock {q.mutex};
+  if(q.tasks.empty())
+  {
+    return false;
+  }
+
+  task = std::move(q.tasks.front());
+  q.tasks.pop_front();
+  --queued_;
+  return true;
+}
+
+bool TaskPool::steal(const std::size_t id, Task& task)
+{
+  const std::size_t n = queues_.size();
+  for(std::size_t offset = 1; offset < n; ++offset)
+  {
+    Queue& q = *queues_[(id + offset) % n];
+    std::lock_guard<std::mutex> lock {q.mutex};
+    if(!q.tasks.empty())
+    {
+      task = std::move(q.tasks.back());
+      q.tasks.pop_back();
+      --queued_;
+      return true;
+    }
+  }
+  return false;
+}
+
+void TaskPool::push(const std::size_t id, Task task)
+{
+  Queue& q = *queues_[id];
+  std::lock_guard<std::mutex> lock {q.mutex};
+  q.tasks.push_back(std::move(task));
+  ++queued_;
+}
+
+void TaskPool::finish()
+{
+  if(--pending_ == 0)
+  {
+    std::lock_guard<std::mutex> lock {done_mutex_};
+    done_cv_.notify_all();
+  }
+}
+
+} // namespace utils
+} // namespace reach
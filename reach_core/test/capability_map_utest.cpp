@@ -0,0 +1,197 @@
+/*
+ * Copyright 2019 Southwest Research Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <reach_core/capability_map.h>
+#include <boost/filesystem.hpp>
+#include <boost/make_shared.hpp>
+#include <gtest/gtest.h>
+#include <cmath>
+
+namespace
+{
+
+const double RESOLUTION = 0.1;
+
+/** @brief Orientation bins are 6 faces of the unit cube with 3x3 cells each */
+const float BIN_FRACTION = 1.0f / 54.0f;
+
+/**
+ * @brief Solver whose samples cycle through two tool orientations in voxel (0, 0, 0) and one in voxel (-4, -1, -1)
+ */
+class SamplingIKSolver : public reach::plugins::IKSolverBase
+{
+public:
+
+  explicit SamplingIKSolver(const bool supported)
+    : supported_(supported)
+  {
+
+  }
+
+  bool initialize(XmlRpc::XmlRpcValue&) override
+  {
+    return true;
+  }
+
+  boost::optional<double> solveIKFromSeed(const Eigen::Isometry3d&,
+                                          const std::map<std::string, double>&,
+                                          std::vector<double>&) override
+  {
+    return {};
+  }
+
+  std::vector<std::string> getJointNames() const override
+  {
+    return {"joint_1"};
+  }
+
+  bool samplePoses(const std::size_t n,
+                   reach::plugins::IsometryVector& poses) override
+  {
+    if (!supported_)
+    {
+      return false;
+    }
+
+    poses.clear();
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      Eigen::Isometry3d pose = Eigen::Isometry3d::Identity();
+      switch (i % 3)
+      {
+        case 0:
+          pose.translation() = Eigen::Vector3d(0.05, 0.05, 0.05);
+          break;
+        case 1:
+          pose.translation() = Eigen::Vector3d(0.05, 0.05, 0.05);
+          pose.linear() = Eigen::AngleAxisd(M_PI, Eigen::Vector3d::UnitX()).toRotationMatrix();
+          break;
+        default:
+          pose.translation() = Eigen::Vector3d(-0.35, -0.05, -0.05);
+          break;
+      }
+      poses.push_back(pose);
+    }
+    return true;
+  }
+
+private:
+
+  const bool supported_;
+};
+
+bool buildMap(reach::core::CapabilityMap& map,
+              const bool supported)
+{
+  reach::utils::TaskPool pool (2);
+  std::vector<reach::plugins::IKSolverBasePtr> solvers;
+  for (std::size_t i = 0; i < pool.size(); ++i)
+  {
+    solvers.push_back(boost::make_shared<SamplingIKSolver>(supported));
+  }
+
+  // Several batches of samples, split over the workers
+  return map.build(pool, solvers, 2500);
+}
+
+class CapabilityMapTest : public ::testing::Test
+{
+public:
+
+  CapabilityMapTest()
+    : filename((boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("reach_cap_%%%%-%%%%")).string())
+    , map(RESOLUTION)
+  {
+
+  }
+
+  ~CapabilityMapTest()
+  {
+    boost::filesystem::remove(filename);
+  }
+
+  const std::string filename;
+  reach::core::CapabilityMap map;
+};
+
+} // namespace anonymous
+
+TEST_F(CapabilityMapTest, Build)
+{
+  ASSERT_TRUE(buildMap(map, true));
+  EXPECT_EQ(map.size(), 2u);
+  EXPECT_FLOAT_EQ(map.getReachability(Eigen::Vector3d(0.05, 0.05, 0.05)), 2.0f * BIN_FRACTION);
+  EXPECT_FLOAT_EQ(map.getReachability(Eigen::Vector3d(-0.35, -0.05, -0.05)), BIN_FRACTION);
+
+  reach::core::CapabilityMap unsupported (RESOLUTION);
+  EXPECT_FALSE(buildMap(unsupported, false));
+  EXPECT_EQ(unsupported.size(), 0u);
+}
+
+TEST_F(CapabilityMapTest, GetReachability)
+{
+  ASSERT_TRUE(buildMap(map, true));
+
+  // Every voxel adjacent to voxel (0, 0, 0), including diagonally, reports its reachability
+  for (int dx = -1; dx <= 1; ++dx)
+  {
+    for (int dy = -1; dy <= 1; ++dy)
+    {
+      for (int dz = -1; dz <= 1; ++dz)
+      {
+        const Eigen::Vector3d position = RESOLUTION * Eigen::Vector3d(dx + 0.5, dy + 0.5, dz + 0.5);
+        EXPECT_FLOAT_EQ(map.getReachability(position), 2.0f * BIN_FRACTION) << dx << " " << dy << " " << dz;
+      }
+    }
+  }
+  EXPECT_FLOAT_EQ(map.getReachability(Eigen::Vector3d(0.25, 0.05, 0.05)), 0.0f);
+
+  // Negative coordinates are rounded down to their voxel, so (-0.15, -0.15, -0.15) is in voxel (-2, -2, -2), which is not adjacent to
+  // voxel (0, 0, 0)
+  EXPECT_FLOAT_EQ(map.getReachability(Eigen::Vector3d(-0.15, -0.15, -0.15)), 0.0f);
+  EXPECT_FLOAT_EQ(map.getReachability(Eigen::Vector3d(-0.25, 0.05, 0.05)), BIN_FRACTION);
+  EXPECT_FLOAT_EQ(map.getReachability(Eigen::Vector3d(-0.45, -0.15, -0.15)), BIN_FRACTION);
+  EXPECT_FLOAT_EQ(map.getReachability(Eigen::Vector3d(-0.55, -0.05, -0.05)), 0.0f);
+}
+
+TEST_F(CapabilityMapTest, SaveAndLoad)
+{
+  ASSERT_TRUE(buildMap(map, true));
+  ASSERT_TRUE(map.save(filename, "robot_a"));
+
+  reach::core::CapabilityMap loaded (RESOLUTION);
+  ASSERT_TRUE(loaded.load(filename, "robot_a"));
+  EXPECT_EQ(loaded.size(), map.size());
+  EXPECT_FLOAT_EQ(loaded.getReachability(Eigen::Vector3d(0.05, 0.05, 0.05)), 2.0f * BIN_FRACTION);
+  EXPECT_FLOAT_EQ(loaded.getReachability(Eigen::Vector3d(-0.35, -0.05, -0.05)), BIN_FRACTION);
+
+  // A map built for another robot or settings, or with another resolution, is not loaded
+  reach::core::CapabilityMap other_key (RESOLUTION);
+  EXPECT_FALSE(other_key.load(filename, "robot_b"));
+  EXPECT_FALSE(other_key.load(filename, "robot_a_2"));
+  EXPECT_EQ(other_key.size(), 0u);
+
+  reach::core::CapabilityMap other_resolution (2.0 * RESOLUTION);
+  EXPECT_FALSE(other_resolution.load(filename, "robot_a"));
+  EXPECT_EQ(other_resolution.size(), 0u);
+
+  EXPECT_FALSE(loaded.load(filename + ".missing", "robot_a"));
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
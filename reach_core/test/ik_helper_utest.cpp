@@ -0,0 +1,336 @@
+/*
+ * Copyright 2019 Southwest Research Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <reach_core/component_analysis.h>
+#include <reach_core/ik_helper.h>
+#include <boost/make_shared.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+
+namespace
+{
+
+/**
+ * @brief Solver of a robot with a single joint, whose position is the x coordinate of the target. Targets beyond a limit are
+ * unreachable, and like an iterative solver it leaves its last estimate in the solution when it fails
+ */
+class LineIKSolver : public reach::plugins::IKSolverBase
+{
+public:
+
+  explicit LineIKSolver(const double limit)
+    : limit_(limit)
+  {
+
+  }
+
+  bool initialize(XmlRpc::XmlRpcValue&) override
+  {
+    return true;
+  }
+
+  boost::optional<double> solveIKFromSeed(const Eigen::Isometry3d& target,
+                                          const std::map<std::string, double>&,
+                                          std::vector<double>& solution) override
+  {
+    ++n_calls;
+    solution = {target.translation().x()};
+    if (target.translation().x() > limit_)
+    {
+      return {};
+    }
+    return 1.0;
+  }
+
+  std::vector<std::string> getJointNames() const override
+  {
+    return {"joint_1"};
+  }
+
+  std::size_t n_calls = 0;
+
+private:
+
+  const double limit_;
+};
+
+reach_msgs::ReachRecord makeLineRecord(const std::size_t id,
+                                       const double x)
+{
+  geometry_msgs::Pose goal;
+  goal.position.x = x;
+  goal.orientation.w = 1.0;
+
+  sensor_msgs::JointState state;
+  state.name = {"joint_1"};
+  state.position = {x};
+  return reach::core::makeRecord(std::to_string(id), true, goal, state, state, 1.0);
+}
+
+/**
+ * @brief Records 0 to 9 along a line at unit spacing, record 10 between records 2 and 3, and an isolated record 20
+ */
+reach::core::ReachDatabasePtr makeLineDatabase()
+{
+  reach::core::ReachDatabasePtr db = std::make_shared<reach::core::ReachDatabase>();
+  for (std::size_t id = 0; id < 10; ++id)
+  {
+    db->put(makeLineRecord(id, static_cast<double>(id)));
+  }
+  db->put(makeLineRecord(10, 2.5));
+  db->put(makeLineRecord(20, 30.0));
+  return db;
+}
+
+std::vector<reach::plugins::IKSolverBasePtr> makeLineSolvers(const reach::utils::TaskPool& pool,
+                                                             const double limit)
+{
+  std::vector<reach::plugins::IKSolverBasePtr> solvers;
+  for (std::size_t i = 0; i < pool.size(); ++i)
+  {
+    solvers.push_back(boost::make_shared<LineIKSolver>(limit));
+  }
+  return solvers;
+}
+
+struct FloodFillMetrics
+{
+  float avg_neighbor_count;
+  float avg_joint_distance;
+};
+
+/**
+ * @brief Computes the neighbor metrics of the study by flood filling from every reached record, normalized as the study does
+ */
+FloodFillMetrics runFloodFill(const reach::core::ReachDatabasePtr& db,
+                              const double limit)
+{
+  auto solver = boost::make_shared<LineIKSolver>(limit);
+  std::size_t neighbor_count = 0;
+  double total_joint_distance = 0.0;
+  for (auto it = db->begin(); it != db->end(); ++it)
+  {
+    const reach_msgs::ReachRecord rec = *it;
+    if (rec.reached)
+    {
+      const reach::core::NeighborReachResult result = reachNeighborsRecursive(db, rec, solver, 1.1);
+      neighbor_count += result.reached_pts.size() - 1;
+      total_joint_distance += result.joint_distance;
+    }
+  }
+
+  FloodFillMetrics metrics;
+  metrics.avg_neighbor_count = static_cast<float>(neighbor_count) / static_cast<float>(db->size());
+  metrics.avg_joint_distance = static_cast<float>(total_joint_distance) / static_cast<float>(neighbor_count);
+  return metrics;
+}
+
+std::vector<std::string> sorted(std::vector<std::string> ids)
+{
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+} // namespace anonymous
+
+TEST(IKHelper, ReachNeighborsRecursive)
+{
+  // A branching line of records that is reachable up to x = 6.5, and an isolated record
+  reach::core::ReachDatabasePtr db = makeLineDatabase();
+
+  const std::vector<std::string> expected = {"0", "1", "10", "2", "3", "4", "5", "6"};
+  const reach_msgs::ReachRecord start = *db->get(0);
+
+  const reach::core::NeighborReachResult result = reachNeighborsRecursive(db, start, boost::make_shared<LineIKSolver>(6.5), 1.1);
+  ASSERT_FALSE(result.reached_pts.empty());
+  EXPECT_EQ(result.reached_pts.front(), "0");
+  EXPECT_EQ(sorted(result.reached_pts), expected);
+
+  // Record 10 is reached from either 2 or 3, which adds 0.5 to the joint distance of the steps along the line
+  EXPECT_DOUBLE_EQ(result.joint_distance, 6.5);
+
+  // Expanding the frontiers in parallel reaches the same records
+  reach::utils::TaskPool pool (4);
+  const std::vector<reach::plugins::IKSolverBasePtr> solvers = makeLineSolvers(pool, 6.5);
+
+  const reach::core::NeighborReachResult parallel_result = reachNeighborsRecursive(db, start, pool, solvers, 1.1);
+  EXPECT_EQ(sorted(parallel_result.reached_pts), expected);
+  EXPECT_DOUBLE_EQ(parallel_result.joint_distance, 6.5);
+
+  // Records that cannot be reached from the start are not visited
+  const reach::core::NeighborReachResult isolated = reachNeighborsRecursive(db, *db->get(20), pool, solvers, 1.1);
+  EXPECT_EQ(isolated.reached_pts, std::vector<std::string>{"20"});
+  EXPECT_DOUBLE_EQ(isolated.joint_distance, 0.0);
+}
+
+TEST(ComponentAnalysis, Run)
+{
+  reach::core::ReachDatabasePtr db = makeLineDatabase();
+
+  reach::utils::TaskPool pool (4);
+  const std::vector<reach::plugins::IKSolverBasePtr> solvers = makeLineSolvers(pool, 6.5);
+
+  reach::core::SpatialIndexPtr index = reach::core::makeSpatialIndex("grid", 1.1);
+  index->update(*db);
+  reach::core::NeighborGraph graph;
+  graph.build(pool, *db, *index, 1.1);
+
+  reach::core::ComponentAnalysis analysis;
+  analysis.run(pool, solvers, *db, graph);
+
+  // The records up to x = 6.5 form one component; the records beyond it and the isolated record are components of their own
+  EXPECT_EQ(analysis.getComponentSizes(), (std::vector<std::size_t>{8, 1, 1, 1, 1}));
+  EXPECT_EQ(analysis.getComponent(10), analysis.getComponent(0));
+  EXPECT_EQ(analysis.getComponent(6), analysis.getComponent(0));
+  EXPECT_NE(analysis.getComponent(7), analysis.getComponent(6));
+  EXPECT_NE(analysis.getComponent(20), analysis.getComponent(0));
+
+  // Each edge is solved once: six unit steps along the line and two half steps to record 10
+  EXPECT_EQ(analysis.getTransitionCount(), 8u);
+  EXPECT_FLOAT_EQ(analysis.getAverageEdgeJointDistance(), 7.0f / 8.0f);
+  EXPECT_FLOAT_EQ(analysis.getAverageConnectedCount(), 8.0f * 7.0f / 12.0f);
+}
+
+TEST(ComponentAnalysis, CompareWithFloodFill)
+{
+  // The line fixture with every record reachable (limit 100), and with the records beyond x = 6.5 unreachable
+  reach::core::ReachDatabasePtr db = makeLineDatabase();
+  reach::core::SpatialIndexPtr index = reach::core::makeSpatialIndex("grid", 1.1);
+  index->update(*db);
+  reach::utils::TaskPool pool (4);
+  reach::core::NeighborGraph graph;
+  graph.build(pool, *db, *index, 1.1);
+
+  {
+    const FloodFillMetrics flood_fill = runFloodFill(db, 100.0);
+    reach::core::ComponentAnalysis analysis;
+    analysis.run(pool, makeLineSolvers(pool, 100.0), *db, graph);
+
+    // When every transition succeeds regardless of direction and seed, each fill reaches exactly the component of its record, so the
+    // neighbor counts agree: 11 records that reach the 10 others, and the isolated record
+    EXPECT_FLOAT_EQ(flood_fill.avg_neighbor_count, 11.0f * 10.0f / 12.0f);
+    EXPECT_FLOAT_EQ(analysis.getAverageConnectedCount(), flood_fill.avg_neighbor_count);
+
+    // The joint distances are normalized differently. Every fill crosses the nine unit steps and one half step, except the fill from
+    // record 10, which takes both half steps instead of the unit step between records 2 and 3; the edges are the nine unit steps and the
+    // two half steps
+    EXPECT_FLOAT_EQ(flood_fill.avg_joint_distance, (10.0f * 9.5f + 9.0f) / 110.0f);
+    EXPECT_FLOAT_EQ(analysis.getAverageEdgeJointDistance(), 10.0f / 11.0f);
+  }
+
+  {
+    const FloodFillMetrics flood_fill = runFloodFill(db, 6.5);
+    reach::core::ComponentAnalysis analysis;
+    analysis.run(pool, makeLineSolvers(pool, 6.5), *db, graph);
+
+    // Reachability is not symmetric: the fill from record 7 reaches record 6 and the 7 other records of its component, but no fill
+    // reaches record 7, so the edge between them is not solved and record 7 forms a component of its own
+    EXPECT_FLOAT_EQ(flood_fill.avg_neighbor_count, (8.0f * 7.0f + 8.0f) / 12.0f);
+    EXPECT_FLOAT_EQ(analysis.getAverageConnectedCount(), 8.0f * 7.0f / 12.0f);
+    // The fill from record 7 adds its step to record 6 to the 6.5 of the other fills of the component
+    EXPECT_FLOAT_EQ(flood_fill.avg_joint_distance, (7.0f * 6.5f + 6.0f + 7.5f) / 64.0f);
+    EXPECT_FLOAT_EQ(analysis.getAverageEdgeJointDistance(), 7.0f / 8.0f);
+  }
+}
+
+TEST(TransitionCache, ReachNeighbors)
+{
+  reach::core::ReachDatabasePtr db = std::make_shared<reach::core::ReachDatabase>();
+  for (std::size_t id = 0; id < 10; ++id)
+  {
+    db->put(makeLineRecord(id, static_cast<double>(id)));
+  }
+
+  auto solver = boost::make_shared<LineIKSolver>(6.5);
+  auto cache = std::make_shared<reach::core::TransitionCache>(100);
+
+  // Repeated searches from the same solution are answered from the cache
+  const reach::core::NeighborReachResult direct = reachNeighborsDirect(db, *db->get(3), solver, 1.1, nullptr, nullptr, cache);
+  EXPECT_EQ(solver->n_calls, 2u);
+  EXPECT_EQ(reachNeighborsDirect(db, *db->get(3), solver, 1.1, nullptr, nullptr, cache).reached_pts, direct.reached_pts);
+  EXPECT_EQ(solver->n_calls, 2u);
+  EXPECT_EQ(cache->getHits(), 2u);
+
+  // Changing the solution of the source record invalidates its transitions
+  reach_msgs::ReachRecord changed = *db->get(3);
+  changed.goal_state.position = {3.25};
+  db->put(changed);
+  EXPECT_EQ(reachNeighborsDirect(db, *db->get(3), solver, 1.1, nullptr, nullptr, cache).reached_pts, direct.reached_pts);
+  EXPECT_EQ(solver->n_calls, 4u);
+
+  // A flood fill from the same record repeats the same transitions
+  const reach::core::NeighborReachResult recursive = reachNeighborsRecursive(db, *db->get(0), solver, 1.1, nullptr, nullptr, cache);
+  const std::size_t n_calls = solver->n_calls;
+  const reach::core::NeighborReachResult repeated = reachNeighborsRecursive(db, *db->get(0), solver, 1.1, nullptr, nullptr, cache);
+  EXPECT_EQ(solver->n_calls, n_calls);
+  EXPECT_EQ(repeated.reached_pts, recursive.reached_pts);
+  EXPECT_DOUBLE_EQ(repeated.joint_distance, recursive.joint_distance);
+}
+
+TEST(TransitionCache, Eviction)
+{
+  reach::core::TransitionCache cache (2, 1);
+  const std::vector<double> seed = {0.0};
+  geometry_msgs::Pose pose;
+  pose.orientation.w = 1.0;
+
+  reach::core::TransitionCache::Transition transition;
+  transition.score = 0.5;
+  transition.solution = {1.0};
+  for (std::size_t target = 1; target <= 3; ++target)
+  {
+    cache.insert(0, 1, target, seed, pose, transition);
+  }
+
+  // The least recently used transition is evicted
+  EXPECT_EQ(cache.size(), 2u);
+  reach::core::TransitionCache::Transition found;
+  EXPECT_FALSE(cache.find(0, 1, 1, seed, pose, found));
+  ASSERT_TRUE(cache.find(0, 1, 2, seed, pose, found));
+  ASSERT_TRUE(found.score);
+  EXPECT_DOUBLE_EQ(*found.score, 0.5);
+  EXPECT_EQ(found.solution, transition.solution);
+
+  // A different seed or target pose is not answered, and a newer version of the source drops the stale transition
+  EXPECT_FALSE(cache.find(0, 1, 3, {0.5}, pose, found));
+  pose.position.x = 1.0;
+  EXPECT_FALSE(cache.find(0, 1, 3, seed, pose, found));
+  pose.position.x = 0.0;
+  EXPECT_FALSE(cache.find(0, 2, 3, seed, pose, found));
+  EXPECT_EQ(cache.size(), 1u);
+}
+
+TEST(IKSolverBase, SolveIKBatch)
+{
+  LineIKSolver solver (1.5);
+  reach::plugins::IsometryVector targets (3, Eigen::Isometry3d::Identity());
+  targets[1].translation().x() = 1.0;
+  targets[2].translation().x() = 2.0;
+
+  std::vector<std::vector<double>> solutions (3, std::vector<double>({5.0}));
+  std::vector<boost::optional<double>> scores;
+  solver.solveIKBatch(targets, std::vector<std::vector<double>>(3, std::vector<double>({0.0})), solutions, scores);
+
+  ASSERT_EQ(scores.size(), 3u);
+  EXPECT_TRUE(scores[0] && scores[1]);
+  EXPECT_FALSE(scores[2]);
+  EXPECT_EQ(solutions, std::vector<std::vector<double>>({{0.0}, {1.0}, {}}));
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
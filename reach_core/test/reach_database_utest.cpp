@@ -0,0 +1,532 @@
+/*
+ * Copyright 2019 Southwest Research Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <reach_core/reach_database.h>
+#include <reach_core/utils/serialization_utils.h>
+#include <boost/filesystem.hpp>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <thread>
+
+namespace
+{
+
+sensor_msgs::JointState makeJointState(const double offset)
+{
+  sensor_msgs::JointState state;
+  state.name = {"joint_1", "joint_2", "joint_3"};
+  state.position = {offset, offset + 1.0, offset + 2.0};
+  return state;
+}
+
+reach_msgs::ReachRecord makeTestRecord(const std::size_t id,
+                                       const bool reached,
+                                       const double score)
+{
+  geometry_msgs::Pose goal;
+  goal.position.x = static_cast<double>(id);
+  goal.position.y = 2.0 * id;
+  goal.position.z = -1.0 * id;
+  goal.orientation.w = 1.0;
+  return reach::core::makeRecord(std::to_string(id), reached, goal, makeJointState(id), makeJointState(10.0 * id), score);
+}
+
+void expectEqual(const reach_msgs::ReachRecord& a,
+                 const reach_msgs::ReachRecord& b)
+{
+  EXPECT_EQ(a.id, b.id);
+  EXPECT_EQ(a.reached, b.reached);
+  EXPECT_DOUBLE_EQ(a.score, b.score);
+  EXPECT_DOUBLE_EQ(a.goal.position.x, b.goal.position.x);
+  EXPECT_DOUBLE_EQ(a.goal.position.y, b.goal.position.y);
+  EXPECT_DOUBLE_EQ(a.goal.position.z, b.goal.position.z);
+  EXPECT_DOUBLE_EQ(a.goal.orientation.w, b.goal.orientation.w);
+  EXPECT_EQ(a.seed_state.name, b.seed_state.name);
+  EXPECT_EQ(a.seed_state.position, b.seed_state.position);
+  EXPECT_EQ(a.goal_state.name, b.goal_state.name);
+  EXPECT_EQ(a.goal_state.position, b.goal_state.position);
+}
+
+std::vector<std::size_t> getIDs(const std::vector<reach::core::RecordView>& views)
+{
+  std::vector<std::size_t> ids;
+  for (const reach::core::RecordView& view : views)
+  {
+    ids.push_back(view.id);
+  }
+  return ids;
+}
+
+class ReachDatabaseTest : public ::testing::Test
+{
+public:
+
+  ReachDatabaseTest()
+    : filename((boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("reach_db_%%%%-%%%%.db")).string())
+  {
+    // Add the records out of order and leave a gap in the IDs
+    const std::vector<std::size_t> ids = {3, 0, 1, 5, 4};
+    for (const std::size_t id : ids)
+    {
+      const reach_msgs::ReachRecord r = makeTestRecord(id, id != 1, 0.1 * (id + 1));
+      db.put(r, id == 4);
+      records.push_back(r);
+    }
+    db.setAverageNeighborsCount(2.5f);
+    db.setNeighborAnalysis("components");
+  }
+
+  ~ReachDatabaseTest()
+  {
+    reach::core::ReachDatabase::remove(filename);
+  }
+
+  const std::string filename;
+  reach::core::ReachDatabase db;
+  std::vector<reach_msgs::ReachRecord> records;
+};
+
+} // namespace anonymous
+
+TEST_F(ReachDatabaseTest, Statistics)
+{
+  const reach::core::StudyResults results = db.getStudyResults();
+  EXPECT_FLOAT_EQ(results.reach_percentage, 80.0f);
+  EXPECT_FLOAT_EQ(results.total_pose_score, 0.4f + 0.1f + 0.6f + 0.5f);
+
+  // Overwriting a record replaces its contribution
+  db.put(makeTestRecord(1, true, 0.2));
+  EXPECT_FLOAT_EQ(db.getStudyResults().reach_percentage, 100.0f);
+  EXPECT_EQ(db.getScoreStatistics().n_records, 5u);
+}
+
+TEST_F(ReachDatabaseTest, SaveAndLoad)
+{
+  db.save(filename);
+
+  reach::core::ReachDatabase loaded;
+  ASSERT_TRUE(loaded.load(filename));
+  ASSERT_EQ(loaded.size(), records.size());
+  EXPECT_FALSE(loaded.contains(2));
+  EXPECT_EQ(loaded.getInterpolatedIDs(), std::vector<std::string>{"4"});
+  EXPECT_FLOAT_EQ(loaded.getStudyResults().reach_percentage, db.getStudyResults().reach_percentage);
+  EXPECT_FLOAT_EQ(loaded.getStudyResults().avg_num_neighbors, 2.5f);
+  EXPECT_EQ(loaded.getStudyResults().neighbor_analysis, "components");
+
+  for (std::size_t i = 0; i < records.size(); ++i)
+  {
+    EXPECT_EQ(loaded.getIDAt(i), db.getIDAt(i));
+    expectEqual(*loaded.get(records[i].id), records[i]);
+  }
+
+  // Modifying a loaded database must not change the other records
+  loaded.put(makeTestRecord(2, true, 1.0));
+  loaded.put(makeTestRecord(8, false, 0.0));
+  for (const reach_msgs::ReachRecord& r : records)
+  {
+    expectEqual(*loaded.get(r.id), r);
+  }
+  expectEqual(*loaded.get(2), makeTestRecord(2, true, 1.0));
+}
+
+TEST_F(ReachDatabaseTest, LoadMerge)
+{
+  db.save(filename);
+
+  reach::core::ReachDatabase merged;
+  merged.put(makeTestRecord(3, false, 0.0));
+  merged.put(makeTestRecord(7, true, 0.7));
+  ASSERT_TRUE(merged.load(filename));
+  EXPECT_EQ(merged.size(), records.size() + 1);
+  EXPECT_TRUE(merged.contains(7));
+  expectEqual(*merged.get(3), makeTestRecord(3, true, 0.4));
+  EXPECT_TRUE(merged.isInterpolated("4"));
+}
+
+TEST_F(ReachDatabaseTest, LoadLegacyFormat)
+{
+  // Databases were previously saved as serialized messages, with the interpolated IDs in a separate file
+  ASSERT_TRUE(reach::utils::toFile(filename, db.toReachDatabaseMsg()));
+  ASSERT_TRUE(reach::utils::toFile(filename + ".interpolated", db.getInterpolatedIDs()));
+
+  reach::core::ReachDatabase loaded;
+  ASSERT_TRUE(loaded.load(filename));
+  ASSERT_EQ(loaded.size(), records.size());
+  EXPECT_TRUE(loaded.isInterpolated("4"));
+
+  // The message format has no neighbor analysis method, and its neighbor metrics were always computed by flood fill
+  EXPECT_FLOAT_EQ(loaded.getStudyResults().avg_num_neighbors, 2.5f);
+  EXPECT_EQ(loaded.getStudyResults().neighbor_analysis, "flood_fill");
+  for (const reach_msgs::ReachRecord& r : records)
+  {
+    expectEqual(*loaded.get(r.id), r);
+  }
+}
+
+TEST_F(ReachDatabaseTest, ReplayLog)
+{
+  db.startLog(filename);
+  db.put(makeTestRecord(1, true, 0.9));
+  db.put(makeTestRecord(6, true, 0.6), true);
+
+  // Saving to the logged file compacts the log, so only the changes after the save remain in it
+  db.save(filename);
+  db.put(makeTestRecord(0, false, 0.0));
+  db.stopLog();
+
+  // Simulate a partially written entry at the end of the log
+  {
+    std::ofstream log ((filename + ".log").c_str(), std::ios::out | std::ios::binary | std::ios::app);
+    log << "partial entry";
+  }
+
+  reach::core::ReachDatabase loaded;
+  ASSERT_TRUE(loaded.load(filename));
+  expectEqual(*loaded.get(0), records[1]);
+  EXPECT_EQ(loaded.replayLog(filename), 1u);
+
+  ASSERT_EQ(loaded.size(), records.size() + 1);
+  expectEqual(*loaded.get(0), makeTestRecord(0, false, 0.0));
+  expectEqual(*loaded.get(1), makeTestRecord(1, true, 0.9));
+  EXPECT_TRUE(loaded.isInterpolated("6"));
+  EXPECT_FLOAT_EQ(loaded.getStudyResults().reach_percentage, db.getStudyResults().reach_percentage);
+
+  // A log is not replayed on top of a later snapshot of the database
+  loaded.save(filename);
+  reach::core::ReachDatabase reloaded;
+  ASSERT_TRUE(reloaded.load(filename));
+  EXPECT_EQ(reloaded.replayLog(filename), 0u);
+}
+
+TEST_F(ReachDatabaseTest, Rename)
+{
+  const std::string new_filename = filename + ".prev";
+
+  // A stale log at the destination must not be replayed on top of the moved database
+  reach::core::ReachDatabase stale;
+  stale.startLog(new_filename);
+  stale.put(makeTestRecord(2, true, 0.3));
+  stale.stopLog();
+
+  db.startLog(filename);
+  db.put(makeTestRecord(1, true, 0.9));
+  db.stopLog();
+  reach::core::ReachDatabase::rename(filename, new_filename);
+  EXPECT_FALSE(boost::filesystem::exists(filename));
+  EXPECT_FALSE(boost::filesystem::exists(filename + ".log"));
+
+  reach::core::ReachDatabase loaded;
+  ASSERT_TRUE(loaded.load(new_filename));
+  EXPECT_EQ(loaded.replayLog(new_filename), 1u);
+  ASSERT_EQ(loaded.size(), records.size());
+  expectEqual(*loaded.get(1), makeTestRecord(1, true, 0.9));
+  EXPECT_TRUE(loaded.isInterpolated("4"));
+
+  // Renaming a database that does not exist leaves the destination as it is
+  reach::core::ReachDatabase::rename(filename, new_filename);
+  EXPECT_TRUE(boost::filesystem::exists(new_filename));
+  reach::core::ReachDatabase::remove(new_filename);
+}
+
+TEST_F(ReachDatabaseTest, ReplayConcurrentLog)
+{
+  // Writers buffer their log entries per stripe, and the log writer collects them periodically without waiting for a save
+  db.startLog(filename);
+  std::vector<std::thread> writers;
+  for (std::size_t t = 0; t < 4; ++t)
+  {
+    writers.emplace_back([this, t]() {
+      for (std::size_t id = 10 + t; id < 1010; id += 4)
+      {
+        db.put(makeTestRecord(id, id % 2 == 0, 0.001 * id));
+      }
+    });
+  }
+  for (std::thread& w : writers)
+  {
+    w.join();
+  }
+
+  const boost::filesystem::path log_path (filename + ".log");
+  for (int i = 0; i < 100 && boost::filesystem::file_size(log_path) == 0; ++i)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  EXPECT_GT(boost::filesystem::file_size(log_path), 0u);
+  db.stopLog();
+
+  reach::core::ReachDatabase loaded;
+  ASSERT_TRUE(loaded.load(filename));
+  EXPECT_EQ(loaded.replayLog(filename), 1000u);
+  ASSERT_EQ(loaded.size(), db.size());
+  for (std::size_t id = 10; id < 1010; ++id)
+  {
+    expectEqual(*loaded.get(id), makeTestRecord(id, id % 2 == 0, 0.001 * id));
+  }
+  EXPECT_EQ(loaded.getScoreStatistics().n_reached, db.getScoreStatistics().n_reached);
+}
+
+TEST_F(ReachDatabaseTest, SaveCompressed)
+{
+  reach::core::StudyCompression compression;
+  compression.enable = true;
+  db.setCompression(compression);
+
+  reach_msgs::ReachRecord r = makeTestRecord(2, true, 0.123456789);
+  r.goal.position.x = 0.123456789;
+  r.goal.orientation.z = 0.707106781;
+  r.goal_state.position[0] = -3.14159265;
+  db.put(r);
+  db.save(filename);
+
+  reach::core::StudyResults results;
+  ASSERT_TRUE(reach::core::ReachDatabase::loadResults(filename, results));
+  EXPECT_FLOAT_EQ(results.reach_percentage, db.getStudyResults().reach_percentage);
+  EXPECT_EQ(results.neighbor_analysis, "components");
+
+  reach::core::ReachDatabase loaded;
+  ASSERT_TRUE(loaded.load(filename));
+  ASSERT_EQ(loaded.size(), records.size() + 1);
+  EXPECT_EQ(loaded.getInterpolatedIDs(), std::vector<std::string>{"4"});
+
+  // Poses and joint states are within half of their resolution, and the scores are exact
+  records.push_back(r);
+  for (const reach_msgs::ReachRecord& expected : records)
+  {
+    const reach_msgs::ReachRecord actual = *loaded.get(expected.id);
+    EXPECT_EQ(actual.reached, expected.reached);
+    EXPECT_EQ(actual.score, expected.score);
+    EXPECT_NEAR(actual.goal.position.x, expected.goal.position.x, compression.position_resolution / 2.0);
+    EXPECT_NEAR(actual.goal.position.y, expected.goal.position.y, compression.position_resolution / 2.0);
+    EXPECT_NEAR(actual.goal.orientation.z, expected.goal.orientation.z, compression.orientation_resolution / 2.0);
+    EXPECT_EQ(actual.goal_state.name, expected.goal_state.name);
+    for (std::size_t j = 0; j < expected.goal_state.position.size(); ++j)
+    {
+      EXPECT_NEAR(actual.seed_state.position[j], expected.seed_state.position[j], compression.joint_resolution / 2.0);
+      EXPECT_NEAR(actual.goal_state.position[j], expected.goal_state.position[j], compression.joint_resolution / 2.0);
+    }
+  }
+}
+
+TEST_F(ReachDatabaseTest, Query)
+{
+  reach::core::ReachQuery query;
+  EXPECT_EQ(getIDs(db.query(query)), (std::vector<std::size_t>{0, 1, 3, 4, 5}));
+
+  query.reached = false;
+  const std::vector<reach::core::RecordView> unreached = db.query(query);
+  ASSERT_EQ(unreached.size(), 1u);
+  EXPECT_EQ(unreached[0].id, 1u);
+  EXPECT_DOUBLE_EQ(unreached[0].score, 0.2);
+  EXPECT_DOUBLE_EQ(unreached[0].position.y, 2.0);
+
+  // Axis-aligned box and ID range
+  query = reach::core::ReachQuery();
+  query.box = reach::core::ReachQuery::Box();
+  query.box->min.x = 0.5;
+  query.box->max.x = 10.0;
+  query.box->min.y = -1.0;
+  query.box->max.y = 8.0;
+  query.box->min.z = -10.0;
+  query.box->max.z = 0.0;
+  query.max_id = 4;
+  EXPECT_EQ(getIDs(db.query(query)), (std::vector<std::size_t>{1, 3, 4}));
+
+  // Score bounds and orders
+  query = reach::core::ReachQuery();
+  query.reached = true;
+  query.min_score = 0.3;
+  EXPECT_EQ(getIDs(db.query(query)), (std::vector<std::size_t>{3, 4, 5}));
+
+  query.min_score = -std::numeric_limits<double>::infinity();
+  query.order = reach::core::ReachQuery::Order::SCORE_ASCENDING;
+  query.limit = 2;
+  EXPECT_EQ(getIDs(db.query(query)), (std::vector<std::size_t>{0, 3}));
+
+  // The score index follows changes to the database
+  db.put(makeTestRecord(2, true, 0.5));
+  query.order = reach::core::ReachQuery::Order::SCORE_DESCENDING;
+  query.limit = 3;
+  EXPECT_EQ(getIDs(db.query(query)), (std::vector<std::size_t>{5, 2, 4}));
+}
+
+TEST_F(ReachDatabaseTest, Versions)
+{
+  EXPECT_EQ(db.getVersion(2), 0u);
+
+  // Writing a record changes only its own version
+  const std::uint64_t version = db.getVersion(3);
+  const std::uint64_t other = db.getVersion(5);
+  db.put(makeTestRecord(3, true, 0.9));
+  EXPECT_NE(db.getVersion(3), version);
+  EXPECT_EQ(db.getVersion(5), other);
+
+  // Loading a database changes the versions of its records
+  db.save(filename);
+  reach::core::ReachDatabase loaded;
+  ASSERT_TRUE(loaded.load(filename));
+  const std::uint64_t loaded_version = loaded.getVersion(5);
+  EXPECT_NE(loaded_version, 0u);
+  ASSERT_TRUE(loaded.load(filename));
+  EXPECT_NE(loaded.getVersion(5), loaded_version);
+}
+
+TEST(ReachDatabase, SaveAndLoadChunks)
+{
+  // Large databases are split into chunks that are encoded and decoded in parallel
+  const std::string filename = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("reach_db_%%%%-%%%%.db")).string();
+  reach::core::ReachDatabase db;
+  for (std::size_t id = 0; id < 50000; id += 1 + id % 3)
+  {
+    db.put(makeTestRecord(id, id % 5 != 0, 0.001 * id), id % 7 == 0);
+  }
+
+  for (const bool enable : {false, true})
+  {
+    reach::core::StudyCompression compression;
+    compression.enable = enable;
+    db.setCompression(compression);
+    db.save(filename);
+
+    reach::core::ReachDatabase loaded;
+    ASSERT_TRUE(loaded.load(filename));
+    ASSERT_EQ(loaded.size(), db.size());
+    EXPECT_EQ(loaded.getInterpolatedIDs(), db.getInterpolatedIDs());
+    for (std::size_t p = 0; p < db.size(); ++p)
+    {
+      const std::size_t id = db.getIDAt(p);
+      ASSERT_EQ(loaded.getIDAt(p), id);
+      const reach_msgs::ReachRecord expected = *db.get(id);
+      const reach_msgs::ReachRecord actual = *loaded.get(id);
+      EXPECT_EQ(actual.reached, expected.reached);
+      EXPECT_EQ(actual.score, expected.score);
+      EXPECT_NEAR(actual.goal.position.y, expected.goal.position.y, compression.position_resolution / 2.0);
+      EXPECT_NEAR(actual.goal_state.position[2], expected.goal_state.position[2], compression.joint_resolution / 2.0);
+    }
+  }
+
+  reach::core::ReachDatabase::remove(filename);
+}
+
+TEST(ReachDatabase, ConcurrentAccess)
+{
+  const std::size_t n_threads = 8;
+  const std::size_t n_records = 4000;
+
+  // Every thread writes the records whose ID matches its index modulo the number of threads, so the writes of each thread span every
+  // stripe. Without reserve(), the first record and every growth of the arrays go through the exclusive path
+  auto makePassRecord = [](const std::size_t id, const std::size_t pass) {
+    return makeTestRecord(id, (id + pass) % 3 != 0, 0.01 * (id % 97 + pass));
+  };
+
+  auto runWriters = [&](reach::core::ReachDatabase& db, const std::size_t first_id, const std::size_t pass) {
+    std::atomic<bool> stop {false};
+    std::atomic<bool> consistent {true};
+
+    // Readers query records and aggregates while the writers run
+    std::vector<std::thread> readers;
+    for (std::size_t t = 0; t < 2; ++t)
+    {
+      readers.emplace_back([&, t]() {
+        std::size_t id = t;
+        while (!stop)
+        {
+          const boost::optional<reach_msgs::ReachRecord> r = db.get(id);
+          if (r && (r->id != std::to_string(id) || r->goal_state.position.size() != 3))
+          {
+            consistent = false;
+          }
+          const reach::core::ScoreStatistics statistics = db.getScoreStatistics();
+          if (statistics.n_reached > statistics.n_records || statistics.n_records > first_id + n_records)
+          {
+            consistent = false;
+          }
+          id = (id + 37) % (first_id + n_records);
+        }
+      });
+    }
+
+    std::vector<std::thread> writers;
+    for (std::size_t t = 0; t < n_threads; ++t)
+    {
+      writers.emplace_back([&, t]() {
+        for (std::size_t id = first_id + t; id < first_id + n_records; id += n_threads)
+        {
+          db.put(makePassRecord(id, pass), id % 11 == 0);
+        }
+      });
+    }
+
+    for (std::thread& w : writers)
+    {
+      w.join();
+    }
+    stop = true;
+    for (std::thread& r : readers)
+    {
+      r.join();
+    }
+    EXPECT_TRUE(consistent.load());
+  };
+
+  auto expectContents = [&](const reach::core::ReachDatabase& db, const std::size_t n, const std::size_t pass_below,
+                            const std::size_t pass_above, const std::size_t split) {
+    ASSERT_EQ(db.size(), n);
+    reach::core::ScoreStatistics expected;
+    for (std::size_t id = 0; id < n; ++id)
+    {
+      const reach_msgs::ReachRecord r = makePassRecord(id, id < split ? pass_below : pass_above);
+      expected.update(r.reached, r.score, 1);
+
+      const boost::optional<reach_msgs::ReachRecord> actual = db.get(id);
+      ASSERT_TRUE(static_cast<bool>(actual));
+      expectEqual(*actual, r);
+      EXPECT_EQ(db.isInterpolated(std::to_string(id)), id % 11 == 0);
+    }
+
+    const reach::core::ScoreStatistics statistics = db.getScoreStatistics();
+    EXPECT_EQ(statistics.n_records, expected.n_records);
+    EXPECT_EQ(statistics.n_reached, expected.n_reached);
+    EXPECT_NEAR(statistics.total_score, expected.total_score, 1.0e-9);
+    EXPECT_EQ(statistics.histogram, expected.histogram);
+  };
+
+  reach::core::ReachDatabase db;
+  runWriters(db, 0, 0);
+  expectContents(db, n_records, 0, 0, 0);
+
+  // Overwriting every record replaces its contribution to the aggregates
+  runWriters(db, 0, 1);
+  expectContents(db, n_records, 1, 1, 0);
+
+  // A loaded database reads its joint states from the file until the first write, which must copy them out under exclusive access.
+  // Overwrite the loaded records and add records beyond the loaded arrays concurrently
+  const std::string filename = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("reach_db_%%%%-%%%%.db")).string();
+  db.save(filename);
+  reach::core::ReachDatabase loaded;
+  ASSERT_TRUE(loaded.load(filename));
+  reach::core::ReachDatabase::remove(filename);
+
+  runWriters(loaded, n_records / 2, 2);
+  expectContents(loaded, n_records / 2 + n_records, 1, 2, n_records / 2);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,243 @@
+/*
+ * Copyright 2019 Southwest Research Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <reach_core/reach_study.h>
+#include <gtest/gtest.h>
+#include <boost/filesystem.hpp>
+#include <cmath>
+#include <map>
+#include <random>
+
+namespace
+{
+
+pcl::PointNormal makePoint(const float x,
+                           const float y,
+                           const float z)
+{
+  pcl::PointNormal pt;
+  pt.x = x;
+  pt.y = y;
+  pt.z = z;
+  pt.normal_x = 0.0f;
+  pt.normal_y = 0.0f;
+  pt.normal_z = 1.0f;
+  return pt;
+}
+
+pcl::PointCloud<pcl::PointNormal>::Ptr makeCloud(const std::vector<pcl::PointNormal>& points)
+{
+  pcl::PointCloud<pcl::PointNormal>::Ptr cloud (new pcl::PointCloud<pcl::PointNormal> ());
+  cloud->points = points;
+  cloud->width = static_cast<uint32_t>(points.size());
+  cloud->height = 1;
+  return cloud;
+}
+
+reach_msgs::ReachRecord makeLineRecord(const std::size_t id,
+                                       const double score)
+{
+  geometry_msgs::Pose goal;
+  goal.position.x = static_cast<double>(id);
+  goal.orientation.w = 1.0;
+
+  sensor_msgs::JointState state;
+  state.name = {"joint_1"};
+  state.position = {static_cast<double>(id)};
+
+  return reach::core::makeRecord(std::to_string(id), true, goal, state, state, score);
+}
+
+class PrepareOptimizationTest : public ::testing::Test
+{
+public:
+
+  PrepareOptimizationTest()
+    : db_filename((boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("reach_%%%%-%%%%.db")).string())
+    , checkpoint_filename((boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("reach_opt_%%%%-%%%%.db")).string())
+  {
+  }
+
+  ~PrepareOptimizationTest()
+  {
+    reach::core::ReachDatabase::remove(db_filename);
+    reach::core::ReachDatabase::remove(checkpoint_filename);
+  }
+
+  /**
+   * @brief Creates the checkpoint of an optimization of the database that was interrupted after improving the score of record 1
+   */
+  void interruptOptimization(const reach::core::ReachDatabase& initial)
+  {
+    reach::core::ReachDatabase opt;
+    opt.put(initial.get(0).get(), initial.isInterpolated("0"));
+    opt.put(initial.get(1).get(), initial.isInterpolated("1"));
+    opt.startLog(checkpoint_filename);
+    opt.put(makeLineRecord(1, 0.7));
+    opt.stopLog();
+  }
+
+  const std::string db_filename;
+  const std::string checkpoint_filename;
+};
+
+} // namespace anonymous
+
+TEST(MatchPoints, Unchanged)
+{
+  reach::utils::TaskPool pool(2);
+  const auto prev = makeCloud({makePoint(0.0f, 0.0f, 0.0f), makePoint(1.0f, 0.0f, 0.0f), makePoint(2.0f, 0.0f, 0.0f)});
+
+  const std::vector<int> matches = reach::core::matchPoints(pool, prev, prev, 0.01, 0.1);
+  EXPECT_EQ(matches, std::vector<int>({0, 1, 2}));
+}
+
+TEST(MatchPoints, OneToOne)
+{
+  reach::utils::TaskPool pool(2);
+  const auto prev = makeCloud({makePoint(0.0f, 0.0f, 0.0f), makePoint(1.0f, 0.0f, 0.0f)});
+
+  // Two new points lie within the tolerance of the first previous point; only the nearer one may take its record
+  const auto cloud = makeCloud({makePoint(0.004f, 0.0f, 0.0f), makePoint(0.001f, 0.0f, 0.0f), makePoint(1.0f, 0.0f, 0.0f)});
+
+  const std::vector<int> matches = reach::core::matchPoints(pool, prev, cloud, 0.01, 0.1);
+  EXPECT_EQ(matches, std::vector<int>({-1, 0, 1}));
+}
+
+TEST(MatchPoints, Normals)
+{
+  reach::utils::TaskPool pool(2);
+  const auto prev = makeCloud({makePoint(0.0f, 0.0f, 0.0f)});
+
+  // A point at the same position whose normal turned beyond the angle tolerance does not match
+  pcl::PointNormal flipped = makePoint(0.0f, 0.0f, 0.0f);
+  flipped.normal_z = -1.0f;
+  const auto cloud = makeCloud({flipped});
+
+  const std::vector<int> matches = reach::core::matchPoints(pool, prev, cloud, 0.01, 0.1);
+  EXPECT_EQ(matches, std::vector<int>({-1}));
+}
+
+TEST(PartitionIntoPhases, Separation)
+{
+  std::mt19937 gen (0);
+  std::uniform_real_distribution<double> dist (-1.0, 1.0);
+
+  reach::core::ReachDatabase db;
+  sensor_msgs::JointState state;
+  state.name = {"joint_1"};
+  state.position = {0.0};
+  for (std::size_t id = 0; id < 2000; ++id)
+  {
+    geometry_msgs::Pose goal;
+    goal.position.x = dist(gen);
+    goal.position.y = dist(gen);
+    goal.position.z = dist(gen);
+    goal.orientation.w = 1.0;
+    db.put(reach::core::makeRecord(std::to_string(id), true, goal, state, state, 0.0));
+  }
+
+  const double radius = 0.15;
+  const std::vector<std::vector<std::vector<std::size_t>>> phases = reach::core::partitionIntoPhases(db, radius);
+
+  // Every record is in exactly one cell
+  std::map<std::size_t, std::size_t> counts;
+  for (const auto& cells : phases)
+  {
+    for (const auto& cell : cells)
+    {
+      for (const std::size_t id : cell)
+      {
+        ++counts[id];
+      }
+    }
+  }
+  ASSERT_EQ(counts.size(), db.size());
+  for (const auto& count : counts)
+  {
+    EXPECT_EQ(count.second, 1u) << "record " << count.first;
+  }
+
+  // Records in different cells of the same phase are at least two radii apart, so they can be optimized concurrently
+  for (const auto& cells : phases)
+  {
+    for (std::size_t a = 0; a < cells.size(); ++a)
+    {
+      for (std::size_t b = a + 1; b < cells.size(); ++b)
+      {
+        for (const std::size_t i : cells[a])
+        {
+          const geometry_msgs::Point p = db.getGoalPosition(i);
+          for (const std::size_t j : cells[b])
+          {
+            const geometry_msgs::Point q = db.getGoalPosition(j);
+            const double d = std::sqrt(std::pow(p.x - q.x, 2) + std::pow(p.y - q.y, 2) + std::pow(p.z - q.z, 2));
+            ASSERT_GE(d, 2.0 * radius) << "records " << i << " and " << j;
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST_F(PrepareOptimizationTest, VerifyDiscardsCheckpoint)
+{
+  reach::core::ReachDatabase db;
+  db.put(makeLineRecord(0, 0.1), true);
+  db.put(makeLineRecord(1, 0.5));
+  interruptOptimization(db);
+
+  const boost::optional<std::size_t> n_changes = reach::core::prepareOptimization(db, db_filename, checkpoint_filename, [&db]() {
+    db.put(makeLineRecord(0, 0.3));
+  });
+  EXPECT_FALSE(n_changes);
+
+  // The verified record is kept, and the checkpoint made from the unverified record is neither merged nor kept
+  EXPECT_FLOAT_EQ(db.get(0)->score, 0.3);
+  EXPECT_FALSE(db.isInterpolated("0"));
+  EXPECT_FLOAT_EQ(db.get(1)->score, 0.5);
+  EXPECT_FALSE(boost::filesystem::exists(checkpoint_filename));
+  EXPECT_FALSE(boost::filesystem::exists(checkpoint_filename + ".log"));
+
+  reach::core::ReachDatabase saved;
+  ASSERT_TRUE(saved.load(db_filename));
+  EXPECT_FLOAT_EQ(saved.get(0)->score, 0.3);
+  EXPECT_TRUE(saved.getInterpolatedIDs().empty());
+}
+
+TEST_F(PrepareOptimizationTest, ResumeFromCheckpoint)
+{
+  // The previous run verified the initial study before it started the interrupted optimization
+  reach::core::ReachDatabase db;
+  db.put(makeLineRecord(0, 0.3));
+  db.put(makeLineRecord(1, 0.5));
+  interruptOptimization(db);
+
+  const boost::optional<std::size_t> n_changes = reach::core::prepareOptimization(db, db_filename, checkpoint_filename, []() {
+    ADD_FAILURE() << "A database without interpolated records is not verified";
+  });
+  ASSERT_TRUE(n_changes);
+  EXPECT_EQ(*n_changes, 1u);
+
+  EXPECT_FLOAT_EQ(db.get(0)->score, 0.3);
+  EXPECT_FLOAT_EQ(db.get(1)->score, 0.7);
+  EXPECT_FALSE(boost::filesystem::exists(db_filename));
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,212 @@
+/*
+ * Copyright 2019 Southwest Research Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <reach_core/neighbor_graph.h>
+#include <reach_core/spatial_index.h>
+#include <boost/filesystem.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <random>
+
+namespace
+{
+
+reach_msgs::ReachRecord makePointRecord(const std::size_t id,
+                                        const double x,
+                                        const double y,
+                                        const double z)
+{
+  geometry_msgs::Pose goal;
+  goal.position.x = x;
+  goal.position.y = y;
+  goal.position.z = z;
+  goal.orientation.w = 1.0;
+
+  sensor_msgs::JointState state;
+  state.name = {"joint_1"};
+  state.position = {0.0};
+  return reach::core::makeRecord(std::to_string(id), true, goal, state, state, 0.0);
+}
+
+std::vector<std::size_t> bruteForceSearch(const reach::core::ReachDatabase& db,
+                                          const geometry_msgs::Point& pt,
+                                          const double radius)
+{
+  std::vector<std::size_t> ids;
+  for (std::size_t p = 0; p < db.size(); ++p)
+  {
+    const std::size_t id = db.getIDAt(p);
+    const geometry_msgs::Point other = db.getGoalPosition(id);
+    const double d2 = std::pow(other.x - pt.x, 2) + std::pow(other.y - pt.y, 2) + std::pow(other.z - pt.z, 2);
+    if (d2 < radius * radius)
+    {
+      ids.push_back(id);
+    }
+  }
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+void testIndex(reach::core::SpatialIndex& index,
+               const double radius)
+{
+  std::mt19937 gen (0);
+  std::uniform_real_distribution<double> dist (-1.0, 1.0);
+
+  // Add records in two batches, with a gap in the IDs, to check that updates pick up the records added since the previous update
+  reach::core::ReachDatabase db;
+  for (std::size_t id = 0; id < 1000; ++id)
+  {
+    db.put(makePointRecord(2 * id, dist(gen), dist(gen), dist(gen)));
+  }
+  index.update(db);
+  EXPECT_EQ(index.radiusSearch(db.getGoalPosition(0), 10.0).size(), 1000u);
+
+  for (std::size_t id = 1000; id < 2000; ++id)
+  {
+    db.put(makePointRecord(2 * id + 1, dist(gen), dist(gen), dist(gen)));
+  }
+  index.update(db);
+
+  for (std::size_t i = 0; i < 100; ++i)
+  {
+    geometry_msgs::Point pt;
+    pt.x = dist(gen);
+    pt.y = dist(gen);
+    pt.z = dist(gen);
+
+    std::vector<std::size_t> ids = index.radiusSearch(pt, radius);
+    std::sort(ids.begin(), ids.end());
+    EXPECT_EQ(ids, bruteForceSearch(db, pt, radius));
+  }
+}
+
+} // namespace anonymous
+
+TEST(SpatialIndex, KdTree)
+{
+  reach::core::KdTreeIndex index;
+  testIndex(index, 0.2);
+}
+
+TEST(SpatialIndex, Grid)
+{
+  reach::core::GridIndex index (0.2);
+  testIndex(index, 0.2);
+
+  // Searches with radii larger than the cell size visit more cells
+  reach::core::GridIndex small_index (0.2);
+  testIndex(small_index, 0.35);
+}
+
+TEST(SpatialIndex, Factory)
+{
+  EXPECT_TRUE(std::dynamic_pointer_cast<reach::core::KdTreeIndex>(reach::core::makeSpatialIndex("kdtree", 0.1)));
+  EXPECT_TRUE(std::dynamic_pointer_cast<reach::core::GridIndex>(reach::core::makeSpatialIndex("grid", 0.1)));
+  EXPECT_FALSE(reach::core::makeSpatialIndex("octree", 0.1));
+}
+
+TEST(NeighborGraph, BuildSaveAndLoad)
+{
+  std::mt19937 gen (0);
+  std::uniform_real_distribution<double> dist (-1.0, 1.0);
+
+  reach::core::ReachDatabase db;
+  for (std::size_t id = 0; id < 3000; ++id)
+  {
+    db.put(makePointRecord(id + id / 100, dist(gen), dist(gen), dist(gen)));
+  }
+
+  const double radius = 0.2;
+  reach::core::GridIndex index (radius);
+  index.update(db);
+
+  reach::utils::TaskPool pool (4);
+  reach::core::NeighborGraph graph;
+  graph.build(pool, db, index, radius);
+  EXPECT_TRUE(graph.matches(db, radius));
+  EXPECT_FALSE(graph.matches(db, 0.3));
+
+  // A radius that went through a different computation still selects the graph
+  EXPECT_TRUE(graph.hasRadius(0.1 * 3.0 - 0.1));
+  EXPECT_FALSE(graph.hasRadius(radius * (1.0 + 1.0e-6)));
+
+  for (std::size_t p = 0; p < db.size(); ++p)
+  {
+    const std::size_t id = db.getIDAt(p);
+    std::vector<std::size_t> expected = bruteForceSearch(db, db.getGoalPosition(id), radius);
+    expected.erase(std::find(expected.begin(), expected.end(), id));
+
+    const reach::core::NeighborGraph::Neighbors neighbors = graph.getNeighbors(id);
+    ASSERT_EQ(std::vector<std::size_t>(neighbors.begin(), neighbors.end()), expected);
+    for (std::size_t i = 0; i < neighbors.size; ++i)
+    {
+      const geometry_msgs::Point a = db.getGoalPosition(id);
+      const geometry_msgs::Point b = db.getGoalPosition(neighbors.ids[i]);
+      EXPECT_NEAR(neighbors.distances[i], std::sqrt(std::pow(a.x - b.x, 2) + std::pow(a.y - b.y, 2) + std::pow(a.z - b.z, 2)), 1.0e-6);
+    }
+  }
+  EXPECT_EQ(graph.getNeighbors(1000000).size, 0u);
+
+  const std::string filename = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("reach_graph_%%%%-%%%%")).string();
+  ASSERT_TRUE(graph.save(filename));
+  reach::core::NeighborGraph loaded;
+  ASSERT_TRUE(loaded.load(filename));
+  boost::filesystem::remove(filename);
+  EXPECT_TRUE(loaded.matches(db, radius));
+  EXPECT_EQ(loaded.size(), graph.size());
+
+  // The graph no longer matches once the target points change
+  db.put(makePointRecord(5000, 0.0, 0.0, 0.0));
+  EXPECT_FALSE(loaded.matches(db, radius));
+}
+
+TEST(NeighborGraph, LoadRejectsInvalidTargets)
+{
+  reach::core::ReachDatabase db;
+  db.put(makePointRecord(0, 0.0, 0.0, 0.0));
+  db.put(makePointRecord(1, 0.1, 0.0, 0.0));
+
+  const double radius = 0.2;
+  reach::core::GridIndex index (radius);
+  index.update(db);
+
+  reach::utils::TaskPool pool (1);
+  reach::core::NeighborGraph graph;
+  graph.build(pool, db, index, radius);
+
+  const std::string filename = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("reach_graph_%%%%-%%%%")).string();
+  ASSERT_TRUE(graph.save(filename));
+
+  // The file ends with the two targets and the size and values of the two distances; point the first target past the last row
+  {
+    std::fstream file (filename.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(-static_cast<std::streamoff>(2 * sizeof(std::uint32_t) + sizeof(std::uint64_t) + 2 * sizeof(float)), std::ios::end);
+    const std::uint32_t target = 2;
+    file.write(reinterpret_cast<const char*>(&target), sizeof(target));
+  }
+
+  reach::core::NeighborGraph loaded;
+  EXPECT_FALSE(loaded.load(filename));
+  boost::filesystem::remove(filename);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
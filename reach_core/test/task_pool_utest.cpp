@@ -0,0 +1,133 @@
+/*
+ * Copyright 2019 Southwest Research Institute
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <reach_core/utils/task_pool.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+
+/**
+ * @brief Runs a parallel for over n indices and checks that every index ran exactly once on a valid worker
+ */
+void checkParallelFor(reach::utils::TaskPool& pool, const std::size_t n)
+{
+  std::vector<std::atomic<int>> counts(n);
+  for (std::atomic<int>& c : counts)
+  {
+    c = 0;
+  }
+  std::atomic<bool> valid_workers {true};
+
+  pool.parallelFor(n, [&](const std::size_t i, const std::size_t worker) {
+    if (worker >= pool.size())
+    {
+      valid_workers = false;
+    }
+    ++counts[i];
+  });
+
+  EXPECT_TRUE(valid_workers.load());
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    EXPECT_EQ(counts[i].load(), 1) << "index " << i;
+  }
+}
+
+} // namespace anonymous
+
+TEST(TaskPool, ParallelForRunsEachIndexOnce)
+{
+  reach::utils::TaskPool pool(4);
+  ASSERT_EQ(pool.size(), 4u);
+
+  checkParallelFor(pool, 0);
+  checkParallelFor(pool, 3);
+  checkParallelFor(pool, 10007);
+
+  // The pool can be reused for further batches
+  checkParallelFor(pool, 1000);
+}
+
+TEST(TaskPool, ThreadCount)
+{
+  // Zero threads uses the hardware threads, but always at least one worker
+  reach::utils::TaskPool hw_pool(0);
+  EXPECT_GE(hw_pool.size(), 1u);
+  checkParallelFor(hw_pool, 500);
+
+  reach::utils::TaskPool single_pool(1);
+  EXPECT_EQ(single_pool.size(), 1u);
+  checkParallelFor(single_pool, 500);
+}
+
+TEST(TaskPool, SubmitAndWait)
+{
+  reach::utils::TaskPool pool(3);
+  std::atomic<std::size_t> count {0};
+  std::atomic<bool> valid_workers {true};
+
+  // Tasks submitted from within a worker run on the same pool
+  for (std::size_t i = 0; i < 100; ++i)
+  {
+    pool.submit([&](const std::size_t worker) {
+      if (worker >= pool.size())
+      {
+        valid_workers = false;
+      }
+      ++count;
+      pool.submit([&](const std::size_t) { ++count; });
+    });
+  }
+  pool.wait();
+
+  EXPECT_TRUE(valid_workers.load());
+  EXPECT_EQ(count.load(), 200u);
+}
+
+TEST(TaskPool, ExceptionPropagation)
+{
+  reach::utils::TaskPool pool(4);
+  std::atomic<std::size_t> count {0};
+
+  EXPECT_THROW(pool.parallelFor(100,
+                                [&](const std::size_t i, const std::size_t) {
+                                  ++count;
+                                  if (i == 42)
+                                  {
+                                    throw std::runtime_error("task failure");
+                                  }
+                                }),
+               std::runtime_error);
+
+  // The remaining tasks still run, and the exception is only reported once
+  EXPECT_EQ(count.load(), 100u);
+  EXPECT_NO_THROW(pool.wait());
+
+  pool.submit([](const std::size_t) { throw std::logic_error("submitted task failure"); });
+  EXPECT_THROW(pool.wait(), std::logic_error);
+
+  // The pool remains usable after a task failed
+  checkParallelFor(pool, 100);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}